@@ -0,0 +1,72 @@
+// link this into the test executable to count the heap allocations for
+// expect(<callable>).to.allocate(), .allocateAtMost(<n>) and .allocateAtMostBytes(<n>)
+
+#include "kaffeeklatsch.hh"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+[[maybe_unused]] bool tracked = (kaffeeklatsch::detail::allocationsTracked = true);
+
+void* allocate(std::size_t size, std::size_t alignment) {
+    auto& allocations = kaffeeklatsch::detail::allocations;
+    ++allocations.count;
+    allocations.bytes += size;
+    if (size == 0) {
+        size = 1;
+    }
+    for (;;) {
+        void* ptr = nullptr;
+        if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ptr = std::malloc(size);
+        } else if (posix_memalign(&ptr, alignment, size) != 0) {
+            ptr = nullptr;
+        }
+        if (ptr) {
+            return ptr;
+        }
+        auto handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* allocate(std::size_t size, std::size_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) { return allocate(size, 0); }
+void* operator new[](std::size_t size) { return allocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocate(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocate(size, static_cast<std::size_t>(alignment)); }
+void* operator new(std::size_t size, const std::nothrow_t& nothrow) noexcept { return allocate(size, 0, nothrow); }
+void* operator new[](std::size_t size, const std::nothrow_t& nothrow) noexcept { return allocate(size, 0, nothrow); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t& nothrow) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment), nothrow);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& nothrow) noexcept {
+    return allocate(size, static_cast<std::size_t>(alignment), nothrow);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
@@ -1,5 +1,39 @@
 #include "kaffeeklatsch.hh"
 
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <utility>
+
 namespace kaffeeklatsch {
 
 enum Status { STATUS_PASSED, STATUS_FAILED, STATUS_SKIPPED };
@@ -34,11 +68,170 @@ auto reversed = "\x1b[7m";
 auto grey = "\x1b[90m";
 auto BrightBlue = "\x1b[94m";
 
+// e.g. when stdout isn't a terminal
+void disable() {
+    for (auto code : {&reset, &black, &red, &green, &yellow, &blue, &magenta, &cyan, &white, &boldBlack, &boldRed, &boldGreen, &boldYellow, &boldBlue,
+                      &boldMagenta, &boldCyan, &boldWhite, &bold, &underline, &noUnderline, &reversed, &grey, &BrightBlue}) {
+        *code = "";
+    }
+}
+
 };  // namespace colour
 
 namespace detail {
 
-static ExampleGroup* currentSuite = nullptr;
+// thread local so that tmp_spec() can be used by examples running on a pool
+static thread_local ExampleGroup* currentSuite = nullptr;
+// the example whose body is being executed, for matchSnapshot()
+static thread_local Example* currentExample = nullptr;
+// set while the cases of a property run on several threads, in which snapshots have no order
+static thread_local bool parallelCases = false;
+
+// when tracing, inherited by the threads of a pool and forked workers
+class Tracer;
+static thread_local Tracer* currentTracer = nullptr;
+
+//
+// work stealing thread pool
+//
+// each worker owns a deque: it pushes it's own tasks at the back, takes them from
+// the front and, when it runs out of work, steals from the front of the other
+// worker's deques. hence tasks submitted first start first, which are the longest
+// ones when their durations are known. statistics are collected per worker and
+// merged once the pool is done.
+//
+class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned size);
+        ~ThreadPool();
+        void submit(std::function<void()> task);
+        void wait();
+        Statistics& statistics() { return workers[workerIndex]->statistics; }
+        void mergeStatistics(Statistics* statistics);
+
+    private:
+        struct alignas(64) Worker {
+                std::mutex mutex;
+                std::deque<std::function<void()>> tasks;
+                Statistics statistics;
+        };
+        bool pop(unsigned self, std::function<void()>* task);
+        void loop(unsigned self);
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        std::atomic<size_t> queued = 0;   // tasks waiting in the deques
+        std::atomic<size_t> pending = 0;  // tasks submitted but not yet finished
+        std::atomic<unsigned> sleeping = 0;
+        std::atomic<unsigned> nextWorker = 0;
+        std::atomic<bool> stopping = false;
+        std::mutex mutex;
+        std::condition_variable workAvailable, allDone;
+        std::exception_ptr error;
+
+        static thread_local ThreadPool* currentPool;
+        static thread_local unsigned workerIndex;
+};
+
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local unsigned ThreadPool::workerIndex = 0;
+
+ThreadPool::ThreadPool(unsigned size) {
+    for (unsigned i = 0; i < size; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < size; ++i) {
+        threads.emplace_back([this, i, tracer = currentTracer] {
+            currentTracer = tracer;
+            loop(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    unsigned index = currentPool == this ? workerIndex : nextWorker++ % workers.size();
+    ++pending;
+    {
+        std::lock_guard lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    ++queued;
+    if (sleeping > 0) {
+        { std::lock_guard lock(mutex); }
+        workAvailable.notify_one();
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock lock(mutex);
+    allDone.wait(lock, [this] { return pending == 0; });
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+void ThreadPool::mergeStatistics(Statistics* statistics) {
+    for (auto& worker : workers) {
+        *statistics += worker->statistics;
+        worker->statistics = Statistics();
+    }
+}
+
+bool ThreadPool::pop(unsigned self, std::function<void()>* task) {
+    for (size_t i = 0; i < workers.size(); ++i) {
+        auto& victim = *workers[(self + i) % workers.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            *task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::loop(unsigned self) {
+    currentPool = this;
+    workerIndex = self;
+    std::function<void()> task;
+    while (true) {
+        if (!pop(self, &task)) {
+            std::unique_lock lock(mutex);
+            ++sleeping;
+            workAvailable.wait(lock, [this] { return queued > 0 || stopping; });
+            --sleeping;
+            if (stopping) {
+                return;
+            }
+            continue;
+        }
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        task = nullptr;
+        if (--pending == 0) {
+            { std::lock_guard lock(mutex); }
+            allDone.notify_all();
+        }
+    }
+}
 
 std::string formatStatus(Status status, const std::string& name) {
     switch (status) {
@@ -51,241 +244,3988 @@ std::string formatStatus(Status status, const std::string& name) {
     }
 }
 
+std::string formatNanoseconds(double ns) {
+    if (ns >= 1e6) {
+        return std::format("{:.1f}ms", ns / 1e6);
+    }
+    if (ns >= 1e3) {
+        return std::format("{:.1f}us", ns / 1e3);
+    }
+    return std::format("{:.1f}ns", ns);
+}
+
+// e.g. "  12.3ns/op  81.3M ops/s  ±1.2%"
+std::string formatBenchmark(const Benchmark& benchmark) {
+    auto throughput = 1e9 / benchmark.mean;
+    auto scale = "";
+    if (throughput >= 1e9) {
+        throughput /= 1e9;
+        scale = "G";
+    } else if (throughput >= 1e6) {
+        throughput /= 1e6;
+        scale = "M";
+    } else if (throughput >= 1e3) {
+        throughput /= 1e3;
+        scale = "k";
+    }
+    return std::format("{}  {}/op  {:.1f}{} ops/s  ±{:.1f}% ({}×{}){}", colour::grey, formatNanoseconds(benchmark.mean), throughput, scale,
+                       100 * benchmark.stddev / benchmark.mean, benchmark.samples, benchmark.iterations, colour::reset);
+}
+
+// used for examples without history
 static auto slow = 75ms;
 
-std::string formatDuration(std::chrono::nanoseconds duration) {
+std::string formatDuration(std::chrono::nanoseconds duration, const Timing& history) {
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(duration);
+    if (history.count > 0) {
+        if (history.regressed(duration)) {
+            return std::format("{} ({}, usually {:.1f}ms){}", colour::red, ms, history.mean / 1e6, colour::reset);
+        }
+        return "";
+    }
     if (ms >= slow) return std::format("{} ({}){}", colour::red, ms, colour::reset);
     if (ms >= slow / 2) return std::format("{} ({}){}", colour::yellow, ms, colour::reset);
     return "";
 }
 
-void report(Statistics* statistics) {
-    currentSuite->scan();
-    currentSuite->evaluate(statistics);
-    --statistics->numTotalTestSuites;  // remove the root group
-    statistics->numTotalTests = statistics->numPassedTests + statistics->numSkippedTests + statistics->numFailedTests;
+//
+// timing database
+//
 
-    std::println("TEST REPORT\n");
-    currentSuite->report("");
+// weight of the latest duration in the moving average
+static const float timingWeight = 0.2;
 
-    if (statistics->numTotalTests > 0) {
-        std::println("");
+void Timing::add(std::chrono::nanoseconds duration) {
+    float value = duration.count();
+    if (count == 0) {
+        mean = value;
+        variance = 0;
+    } else {
+        auto delta = value - mean;
+        mean += timingWeight * delta;
+        variance = (1 - timingWeight) * (variance + timingWeight * delta * delta);
     }
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(statistics->totalDuration);
-    std::println("{}Finished {} tests in {} test suites in {}", colour::green, statistics->numTotalTests, statistics->numTotalTestSuites, ms);
-    std::println("");
+    if (count < std::numeric_limits<uint32_t>::max()) {
+        ++count;
+    }
+}
 
-    if (statistics->numTotalTests > 0) {
-        std::println("{}{}SUMMARY:{}\n", colour::boldWhite, colour::underline, colour::reset);
+// it's a regression when a duration exceeds the mean by 50%, 3 standard deviations
+// and 1ms, the latter to ignore the jitter of very short examples
+bool Timing::regressed(std::chrono::nanoseconds duration) const {
+    if (count < 3) {
+        return false;
     }
-    if (statistics->numPassedTests != 0) {
-        std::println("{}", formatStatus(STATUS_PASSED, std::format("{} tests completed", statistics->numPassedTests)));
+    float value = duration.count();
+    return value > mean * 1.5f && value > mean + 3 * std::sqrt(variance) && value - mean > 1e6f;
+}
+
+// file format: "kktd", u32 version, u32 count, count * (u64 id, f32 mean, f32 variance, u32 count)
+static const char timingMagic[4] = {'k', 'k', 't', 'd'};
+static const uint32_t timingVersion = 1;
+
+bool TimingDatabase::load(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        return false;
     }
-    if (statistics->numSkippedTests != 0) {
-        std::println("{}", formatStatus(STATUS_SKIPPED, std::format("{} tests skipped", statistics->numSkippedTests)));
+    char magic[4];
+    uint32_t version, size;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!in || std::memcmp(magic, timingMagic, sizeof(magic)) != 0 || version != timingVersion) {
+        return false;
     }
-    if (statistics->numFailedTests != 0) {
-        std::println("{}", formatStatus(STATUS_FAILED, std::format("{} tests failed", statistics->numFailedTests)));
+    // the count is only trusted as far as the file holds that many records
+    constexpr size_t recordSize = sizeof(uint64_t) + sizeof(Timing::mean) + sizeof(Timing::variance) + sizeof(Timing::count);
+    auto records = in.tellg();
+    in.seekg(0, std::ios::end);
+    auto available = static_cast<size_t>(in.tellg() - records) / recordSize;
+    in.seekg(records);
+    if (!in || available < size) {
+        return false;
     }
-    if (statistics->numTotalTests > 0) {
-        std::println("");
+    timings.clear();
+    timings.reserve(size);
+    for (uint32_t i = 0; i < size; ++i) {
+        uint64_t id;
+        Timing timing;
+        in.read(reinterpret_cast<char*>(&id), sizeof(id));
+        in.read(reinterpret_cast<char*>(&timing.mean), sizeof(timing.mean));
+        in.read(reinterpret_cast<char*>(&timing.variance), sizeof(timing.variance));
+        in.read(reinterpret_cast<char*>(&timing.count), sizeof(timing.count));
+        if (!in) {
+            timings.clear();
+            return false;
+        }
+        timings[id] = timing;
     }
+    return true;
+}
 
-    if (statistics->numFailedTests != 0) {
-        std::println("{}{}FAILED TESTS:{}\n", colour::boldWhite, colour::underline, colour::reset);
-        currentSuite->reportFailures("");
-        std::println("");
+bool TimingDatabase::save(const std::string& filename) const {
+    std::string buffer(timingMagic, sizeof(timingMagic));
+    auto append = [&](const auto& value) { buffer.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    append(timingVersion);
+    append(static_cast<uint32_t>(timings.size()));
+    for (auto& [id, timing] : timings) {
+        append(id);
+        append(timing.mean);
+        append(timing.variance);
+        append(timing.count);
     }
-    std::println("{}", colour::reset);
+    // write to a temporary file first so that an interrupted run doesn't leave a truncated database
+    auto tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(buffer.data(), buffer.size());
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(tmp.c_str(), filename.c_str()) == 0;
 }
 
-Item::~Item() {}
+const Timing* TimingDatabase::find(uint64_t id) const {
+    auto it = timings.find(id);
+    return it == timings.end() ? nullptr : &it->second;
+}
 
-void ExampleGroup::scan() {
-    for (auto& item : items) {
-        item->m_skip = item->m_skip || m_skip;
-        item->scan();
-        m_has_focus_child = m_has_focus_child || item->m_has_focus_child || item->m_focus;
+//
+// status database
+//
+// a text file with one line per failed example: <id in hex> <path>
+//
+
+bool StatusDatabase::load(const std::string& filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        return false;
+    }
+    failed.clear();
+    paths.clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        uint64_t id;
+        auto [end, ec] = std::from_chars(line.data(), line.data() + line.size(), id, 16);
+        if (ec != std::errc()) {
+            continue;
+        }
+        failed.insert(id);
+        if (end != line.data() + line.size()) {
+            paths[id] = line.substr(end + 1 - line.data());
+        }
     }
+    return true;
 }
 
-void Example::scan() {}
+bool StatusDatabase::save(const std::string& filename) const {
+    // write to a temporary file first so that an interrupted run doesn't lose the failures
+    auto tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (auto id : failed) {
+            auto path = paths.find(id);
+            out << std::format("{:016x} {}\n", id, path != paths.end() ? path->second : "");
+        }
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(tmp.c_str(), filename.c_str()) == 0;
+}
 
-void ExampleGroup::evaluate(Statistics* statistics) {
-    ++statistics->numTotalTestSuites;
-    for (auto& call : beforeAll) {
-        call();
+// one line per benchmark: "<id> <n> <sample>... <path>"
+bool BaselineDatabase::load(const std::string& filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        return false;
     }
-    for (auto& item : items) {
-        if (m_has_focus_child && !(item->m_has_focus_child || item->m_focus)) {
+    entries.clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        uint64_t id;
+        size_t n;
+        if (!(fields >> std::hex >> id >> std::dec >> n)) {
             continue;
         }
-        item->evaluate(statistics);
+        Entry entry;
+        double sample;
+        while (entry.samples.size() < n && fields >> sample) {
+            entry.samples.push_back(sample);
+        }
+        if (entry.samples.size() != n || n == 0) {
+            continue;
+        }
+        fields.get();
+        std::getline(fields, entry.path);
+        entries[id] = std::move(entry);
     }
-    for (auto& call : afterAll) {
-        call();
+    return true;
+}
+
+bool BaselineDatabase::save(const std::string& filename) const {
+    // write to a temporary file first so that an interrupted run doesn't destroy the baseline
+    auto tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (auto& [id, entry] : entries) {
+            out << std::format("{:016x} {}", id, entry.samples.size());
+            for (auto sample : entry.samples) {
+                out << std::format(" {}", sample);
+            }
+            out << std::format(" {}\n", entry.path);
+        }
+        if (!out) {
+            return false;
+        }
     }
+    return std::rename(tmp.c_str(), filename.c_str()) == 0;
 }
 
-void Example::evaluateBeforeEach(ExampleGroup *group) {
-    if (!group) {
-        return;
+const std::vector<double>* BaselineDatabase::find(uint64_t id) const {
+    auto entry = entries.find(id);
+    return entry != entries.end() ? &entry->second.samples : nullptr;
+}
+
+void BaselineDatabase::update(ExampleGroup* group) {
+    for (auto& item : group->items) {
+        if (!group->selected(item.get())) {
+            continue;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            update(child);
+        } else {
+            auto example = static_cast<Example*>(item.get());
+            if (example->m_bench && example->passed && !example->skipped && example->benchmark.samples > 0) {
+                auto& values = example->benchmark.values;
+                entries[example->m_id] = {{values.begin(), values.begin() + example->benchmark.samples}, example->path()};
+            }
+        }
     }
-    if (group->parent) {
-        evaluateBeforeEach(group->parent);
+}
+
+// file format: "kksn", u32 version, u32 count, count * (u64 id, u32 index, u64 hash, u64 data size,
+// data) with the id of Item::m_id. the data isn't aligned, it's only accessed as bytes
+static const char snapshotMagic[4] = {'k', 'k', 's', 'n'};
+static const uint32_t snapshotVersion = 2;
+
+namespace {
+
+// 8 bytes per step instead of fnv1a()'s one, to tell changed snapshots of many megabytes apart
+uint64_t contentHash(std::string_view data) {
+    uint64_t hash = 0xcbf29ce484222325ull ^ data.size();
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data.data() + i, 8);
+        hash = (std::rotl(hash, 29) ^ word) * 0x9e3779b97f4a7c15ull;
     }
-    for (auto& call : group->beforeEach) {
-        call();
+    uint64_t tail = 0;
+    // data() may be null when it's empty
+    if (i < data.size()) {
+        std::memcpy(&tail, data.data() + i, data.size() - i);
     }
+    hash = (std::rotl(hash, 29) ^ tail) * 0x9e3779b97f4a7c15ull;
+    return hash ^ (hash >> 32);
 }
 
-void Example::evaluateAfterEach(ExampleGroup *group) {
-    if (!group) {
-        return;
-    }
-    for (auto& call : group->afterEach) {
-        call();
+template <typename T>
+void appendValue(std::string* out, const T& value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readValue(std::string_view* in, T* value) {
+    if (in->size() < sizeof(T)) {
+        return false;
     }
-    if (group->parent) {
-        evaluateAfterEach(group->parent);
+    std::memcpy(value, in->data(), sizeof(T));
+    in->remove_prefix(sizeof(T));
+    return true;
+}
+
+// an entry in the file format without the data, which follows
+std::string snapshotHeader(uint64_t id, unsigned index, uint64_t hash, size_t size) {
+    std::string out;
+    appendValue(&out, id);
+    appendValue(&out, static_cast<uint32_t>(index));
+    appendValue(&out, hash);
+    appendValue(&out, static_cast<uint64_t>(size));
+    return out;
+}
+
+// the entries of the file format until in is empty, false when it's corrupt
+bool parseSnapshots(std::string_view in, const std::function<void(uint64_t id, unsigned index, uint64_t hash, std::string_view data)>& entry) {
+    while (!in.empty()) {
+        uint64_t id, hash, dataSize;
+        uint32_t index;
+        if (!readValue(&in, &id) || !readValue(&in, &index) || !readValue(&in, &hash) || !readValue(&in, &dataSize) || in.size() < dataSize) {
+            return false;
+        }
+        entry(id, index, hash, in.substr(0, dataSize));
+        in.remove_prefix(dataSize);
     }
+    return true;
 }
 
-void Example::evaluate(Statistics* statistics) {
-    auto begin = std::chrono::high_resolution_clock::now();
-    try {
-        if (m_skip) {
-            skipped = true;
-        } else {
-            evaluateBeforeEach(parent);
-            body();
-            evaluateAfterEach(parent);
+void collectSnapshots(ExampleGroup* group, bool selected, std::unordered_map<uint64_t, unsigned>* matched, std::unordered_set<uint64_t>* declared) {
+    for (auto& item : group->items) {
+        bool itemSelected = selected && group->selected(item.get());
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            collectSnapshots(child, itemSelected, matched, declared);
+            continue;
         }
-    } catch (assertion_error const& ex) {
-        passed = false;
-        error = ex;
-    } catch (std::exception const& ex) {
-        passed = false;
-        error = assertion_error(ex.what(), "unknown", 0);
-    } catch (...) {
-        passed = false;
-        error = assertion_error("catch all", "unknown", 0);
+        auto example = static_cast<Example*>(item.get());
+        if (itemSelected && example->passed && !example->skipped) {
+            (*matched)[example->m_id] = example->snapshots;
+        }
+        declared->insert(example->m_id);
     }
-    auto end = std::chrono::high_resolution_clock::now();
-    duration = end - begin;
-    statistics->totalDuration += duration;
-    if (skipped) {
-        ++statistics->numSkippedTests;
-    } else {
-        if (passed) {
-            ++statistics->numPassedTests;
-        } else {
-            ++statistics->numFailedTests;
+}
+
+// whether no sibling of the item has the same name. groups with the same name are told apart by
+// their order in Item::m_id already, and checking each of them for each snapshot isn't cheap
+bool uniquePath(const Item* item) {
+    if (item->parent) {
+        for (auto& sibling : item->parent->items) {
+            if (sibling.get() != item && sibling->name == item->name) {
+                return false;
+            }
         }
     }
+    return true;
 }
 
-void ExampleGroup::report(const std::string& indent) {
-    auto nextIndent = indent + "  ";
-    std::println("{}{}{}{}", indent, colour::boldWhite, name, colour::reset);
-    for (auto& item : items) {
-        if (m_has_focus_child && !(item->m_has_focus_child || item->m_focus)) {
-            continue;
+}  // namespace
+
+SnapshotStore::~SnapshotStore() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+bool SnapshotStore::load(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(snapshotMagic) + 2 * sizeof(uint32_t))) {
+        ::close(fd);
+        return false;
+    }
+    auto address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    std::string_view in(static_cast<const char*>(address), status.st_size);
+    uint32_t version, size;
+    bool valid = in.starts_with(std::string_view(snapshotMagic, sizeof(snapshotMagic)));
+    in.remove_prefix(sizeof(snapshotMagic));
+    valid = valid && readValue(&in, &version) && readValue(&in, &size) && version == snapshotVersion;
+    std::map<std::pair<uint64_t, unsigned>, Entry> loaded;
+    valid = valid && parseSnapshots(in, [&](uint64_t id, unsigned index, uint64_t hash, std::string_view data) { loaded[{id, index}] = {hash, data, {}}; });
+    if (!valid || loaded.size() != size) {
+        munmap(address, status.st_size);
+        return false;
+    }
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+    mapping = address;
+    mappingSize = status.st_size;
+    entries = std::move(loaded);
+    m_changed = false;
+    return true;
+}
+
+bool SnapshotStore::save(const std::string& filename) const {
+    // write to a temporary file first so that an interrupted run doesn't leave a truncated store,
+    // the mapping of the previous file stays valid after the rename
+    auto tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        std::string header(snapshotMagic, sizeof(snapshotMagic));
+        appendValue(&header, snapshotVersion);
+        appendValue(&header, static_cast<uint32_t>(entries.size()));
+        out << header;
+        for (auto& [key, entry] : entries) {
+            out << snapshotHeader(key.first, key.second, entry.hash, entry.data.size());
+            out.write(entry.data.data(), entry.data.size());
+        }
+        if (!out) {
+            return false;
         }
-        item->report(nextIndent);
     }
+    return std::rename(tmp.c_str(), filename.c_str()) == 0;
 }
 
-void Example::report(const std::string& indent) {
-    auto status = STATUS_FAILED;
-    if (skipped) {
-        status = STATUS_SKIPPED;
-    } else {
-        if (passed) {
-            status = STATUS_PASSED;
+std::optional<std::string> SnapshotStore::match(uint64_t id, unsigned index, std::string_view data, bool text) {
+    auto hash = contentHash(data);
+    std::string_view stored;
+    {
+        std::lock_guard lock(mutex);
+        auto key = std::pair{id, index};
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.hash == hash) {
+            return {};
+        }
+        if (it == entries.end() || update) {
+            auto& entry = entries[key];
+            entry.hash = hash;
+            entry.owned.assign(data);
+            entry.data = entry.owned;
+            recorded.push_back(std::move(key));
+            m_changed = true;
+            return {};
         }
+        // only the example evaluating id replaces it's snapshots, so the data stays valid
+        stored = it->second.data;
     }
-    std::println("{}{}{}", indent, formatStatus(status, name), formatDuration(duration));
+    if (text) {
+        return std::format("snapshot {} differs, {}", index, describeInequality(data, stored));
+    }
+    auto expected = std::as_bytes(std::span(stored.data(), stored.size())), actual = std::as_bytes(std::span(data.data(), data.size()));
+    auto first = firstMismatch(actual.data(), expected.data(), std::min(actual.size(), expected.size()));
+    return std::format("snapshot {} differs, expected {} bytes to equal {} bytes, first difference at offset 0x{:x} (- expected, + actual):", index,
+                       actual.size(), expected.size(), first) +
+           formatBytesDiff(expected, actual, first);
 }
 
-void ExampleGroup::reportFailures(const std::string& path) {
-    for (auto& item : items) {
-        item->reportFailures(path.size() == 0 ? name : std::format("{} > {}", path, name));
+void SnapshotStore::prune(ExampleGroup* root) {
+    std::unordered_map<uint64_t, unsigned> matched;
+    std::unordered_set<uint64_t> declared;
+    collectSnapshots(root, true, &matched, &declared);
+    // the groups not on one of the --path=<path> weren't declared
+    bool complete = root->m_paths.empty();
+    std::lock_guard lock(mutex);
+    std::erase_if(entries, [&](auto& entry) {
+        auto& [id, index] = entry.first;
+        auto count = matched.find(id);
+        bool obsolete = (count != matched.end() && index > count->second) || (complete && !declared.contains(id));
+        m_changed = m_changed || obsolete;
+        return obsolete;
+    });
+}
+
+std::string SnapshotStore::takeRecorded() {
+    std::lock_guard lock(mutex);
+    std::string out;
+    for (auto& key : recorded) {
+        auto& entry = entries[key];
+        out += snapshotHeader(key.first, key.second, entry.hash, entry.data.size());
+        out += entry.data;
     }
+    recorded.clear();
+    return out;
 }
 
-void Example::reportFailures(const std::string& path) {
-    if (!passed) {
-        std::println("  {}∙ {} > {}{}", colour::red, path, name, colour::reset);
-        std::println("    {}:{}: {}", error.filename, error.line, error.what());
+void SnapshotStore::addRecorded(std::string_view in) {
+    std::lock_guard lock(mutex);
+    parseSnapshots(in, [&](uint64_t id, unsigned index, uint64_t hash, std::string_view data) {
+        auto& entry = entries[{id, index}];
+        entry.hash = hash;
+        entry.owned.assign(data);
+        entry.data = entry.owned;
+        m_changed = true;
+    });
+}
+
+void matchSnapshot(std::string_view data, bool text, const char* filename, unsigned line) {
+    auto example = currentExample;
+    if (parallelCases) {
+        throw assertion_error("matchSnapshot() can't be used in a property() running it's cases in parallel", filename, line);
+    }
+    if (!example || !example->m_snapshots) {
+        throw assertion_error("matchSnapshot() needs the snapshots, which are disabled with --snapshots=", filename, line);
+    }
+    // siblings with the same name would be told apart only by their order
+    if (!uniquePath(example)) {
+        throw assertion_error(std::format("matchSnapshot() needs a unique path but '{}' is declared more than once", example->path()), filename, line);
+    }
+    if (auto message = example->m_snapshots->match(example->m_id, ++example->snapshots, data, text)) {
+        throw assertion_error(*message, filename, line);
     }
 }
 
-// this one is for testing purposes
-void tmp_spec(std::function<void()> body, std::function<void(const Statistics&)> verify) {
-    auto previousSuite = currentSuite;
-    // std::println(">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>");
-    detail::ExampleGroup root(nullptr, "", [] {});
-    detail::currentSuite = &root;
-    body();
-    Statistics statistics;
-#if 0    
-    detail::report(&statistics);
-#else
-    // FIXME: duplicate code from detail::report()
-    currentSuite->scan();
-    currentSuite->evaluate(&statistics);
-    --statistics.numTotalTestSuites;  // remove the root group
-    statistics.numTotalTests = statistics.numPassedTests + statistics.numSkippedTests + statistics.numFailedTests;
-#endif
-    currentSuite = previousSuite;
+// U counts the pairs in which the value of a is greater, ties count half. for the few
+// samples of a benchmark the distribution of U is enumerated, the normal approximation
+// is used only above
+double mannWhitneyU(const std::vector<double>& a, const std::vector<double>& b) {
+    size_t n1 = a.size(), n2 = b.size();
+    if (n1 == 0 || n2 == 0) {
+        return 1;
+    }
+    double u = 0;
+    for (auto x : a) {
+        for (auto y : b) {
+            u += x > y ? 1 : x == y ? 0.5 : 0;
+        }
+    }
+    if (n1 * n2 > 1024) {
+        double mean = n1 * n2 / 2.0;
+        double sigma = std::sqrt(n1 * n2 * (n1 + n2 + 1) / 12.0);
+        return std::erfc((u - 0.5 - mean) / sigma / std::sqrt(2.0)) / 2;
+    }
+    // f[n][k]: orderings of m values of a and n values of b in which k pairs have the value
+    // of a greater, the greatest value is either one of a (above all n of b) or one of b
+    size_t max = n1 * n2;
+    std::vector<std::vector<double>> f(n2 + 1, std::vector<double>(max + 1, 0));
+    for (auto& row : f) {
+        row[0] = 1;
+    }
+    for (size_t m = 1; m <= n1; ++m) {
+        std::vector<std::vector<double>> g(n2 + 1, std::vector<double>(max + 1, 0));
+        g[0][0] = 1;
+        for (size_t n = 1; n <= n2; ++n) {
+            for (size_t k = 0; k <= m * n; ++k) {
+                g[n][k] = (k >= n ? f[n][k - n] : 0) + g[n - 1][k];
+            }
+        }
+        f = std::move(g);
+    }
+    double total = 0, tail = 0;
+    for (size_t k = 0; k <= max; ++k) {
+        total += f[n2][k];
+        if (k >= u) {
+            tail += f[n2][k];
+        }
+    }
+    return tail / total;
+}
 
-    verify(statistics);
-    // std::println("<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<");
+double shiftEstimate(const std::vector<double>& a, const std::vector<double>& b) {
+    std::vector<double> differences;
+    differences.reserve(a.size() * b.size());
+    for (auto x : a) {
+        for (auto y : b) {
+            differences.push_back(x - y);
+        }
+    }
+    if (differences.empty()) {
+        return 0;
+    }
+    std::sort(differences.begin(), differences.end());
+    return (differences[(differences.size() - 1) / 2] + differences[differences.size() / 2]) / 2;
 }
 
-}  // namespace detail
+namespace {
 
-int run(int, char*[]) {
-    std::println("{}TEST RUN:\n\n{}START:{}\n", colour::boldWhite, colour::underline, colour::reset);
-    detail::ExampleGroup root(nullptr, "", [] {});
-    detail::currentSuite = &root;
-    for (auto& suite : detail::specs()) {
-        suite();
+void assignBaselines(ExampleGroup* group, const BaselineDatabase& baselines, double significance, double threshold) {
+    for (auto& item : group->items) {
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            assignBaselines(child, baselines, significance, threshold);
+        } else if (auto samples = baselines.find(item->m_id)) {
+            auto example = static_cast<Example*>(item.get());
+            example->baseline = *samples;
+            example->m_significance = significance;
+            example->m_threshold = threshold;
+        }
     }
-    detail::Statistics statistics;
-    detail::report(&statistics);
-    detail::currentSuite = nullptr;
-    return 0;
 }
 
-detail::ExampleGroup& describe(const std::string& groupname, std::function<void()> body) {
-    auto parentSuite = detail::currentSuite;
-    auto group = std::make_unique<detail::ExampleGroup>(parentSuite, groupname, body);
-    detail::ExampleGroup* ptr = group.get();
-    detail::currentSuite = ptr;
-    parentSuite->items.push_back(std::move(group));
-    body();
-    detail::currentSuite = parentSuite;
-    return *ptr;
+void assignSnapshots(ExampleGroup* group, SnapshotStore* snapshots) {
+    for (auto& item : group->items) {
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            assignSnapshots(child, snapshots);
+        } else {
+            static_cast<Example*>(item.get())->m_snapshots = snapshots;
+        }
+    }
 }
 
-detail::ExampleGroup& fdescribe(const std::string& groupname, std::function<void()> body) { return describe(groupname, body).only(); }
-detail::ExampleGroup& xdescribe(const std::string& groupname, std::function<void()> body) { return describe(groupname, body).skip(); }
-detail::ExampleGroup& describe(const std::string& groupname) { return xdescribe(groupname, []{}); }
+void assignProperties(ExampleGroup* group, unsigned cases, uint64_t seed) {
+    for (auto& item : group->items) {
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            assignProperties(child, cases, seed);
+        } else if (auto example = static_cast<Example*>(item.get()); example->m_property) {
+            if (!example->m_cases) {
+                example->m_cases = cases;
+            }
+            example->m_seed = seed;
+        }
+    }
+}
 
-detail::Example& it(const std::string& examplename, std::function<void()> body) {
-    auto parentSuite = detail::currentSuite;
-    auto example = std::make_unique<detail::Example>(parentSuite, examplename, body);
-    detail::Example* ptr = example.get();
-    parentSuite->items.push_back(std::move(example));
-    return *ptr;
+void enableCounters(ExampleGroup* group) {
+    for (auto& item : group->items) {
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            enableCounters(child);
+        } else {
+            static_cast<Example*>(item.get())->m_counters = true;
+        }
+    }
 }
 
-detail::Example& fit(const std::string& examplename, std::function<void()> body) { return it(examplename, body).only(); }
-detail::Example& xit(const std::string& examplename, std::function<void()> body) { return it(examplename, body).skip(); }
-detail::Example& it(const std::string& examplename) { return xit(examplename, []{}); }
+void collectHistory(ExampleGroup* group, const TimingDatabase& timings, double* sum, size_t* count) {
+    for (auto& item : group->items) {
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            collectHistory(child, timings, sum, count);
+        } else if (auto timing = timings.find(item->m_id)) {
+            auto example = static_cast<Example*>(item.get());
+            example->history = *timing;
+            *sum += timing->mean;
+            ++*count;
+        }
+    }
+}
+
+// set m_expected, examples without history are expected to take the average time
+double estimate(ExampleGroup* group, double unknown) {
+    group->m_expected = 0;
+    for (auto& item : group->items) {
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            group->m_expected += estimate(child, unknown);
+        } else {
+            auto example = static_cast<Example*>(item.get());
+            example->m_expected = example->m_skip ? 0 : example->history.count > 0 ? example->history.mean : unknown;
+            group->m_expected += example->m_expected;
+        }
+    }
+    return group->m_expected;
+}
+
+void recordTimings(ExampleGroup* group, TimingDatabase* timings) {
+    for (auto& item : group->items) {
+        if (!group->selected(item.get())) {
+            continue;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            recordTimings(child, timings);
+        } else {
+            auto example = static_cast<Example*>(item.get());
+            if (!example->skipped && example->passed) {
+                timings->add(example->m_id, example->duration);
+            }
+        }
+    }
+}
+
+void collectIds(ExampleGroup* group, std::unordered_set<uint64_t>* ids) {
+    for (auto& item : group->items) {
+        ids->insert(item->m_id);
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            collectIds(child, ids);
+        }
+    }
+}
+
+void updateStatus(ExampleGroup* group, std::unordered_set<uint64_t>* failed, std::unordered_map<uint64_t, std::string>* paths) {
+    for (auto& item : group->items) {
+        if (!group->selected(item.get())) {
+            continue;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            updateStatus(child, failed, paths);
+        } else {
+            auto example = static_cast<Example*>(item.get());
+            if (example->skipped) {
+                continue;
+            }
+            if (example->passed) {
+                failed->erase(example->m_id);
+            } else {
+                failed->insert(example->m_id);
+                (*paths)[example->m_id] = example->path();
+            }
+        }
+    }
+}
+
+uint64_t fnv1a(uint64_t hash, std::string_view data) {
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+}  // namespace
+
+//
+// tracing
+//
+// spans are collected per thread without locking and written in the Chrome trace
+// event format (chrome://tracing, ui.perfetto.dev) once the run is done. forked
+// workers send theirs along with each result. groups are async events as their
+// beforeAll() and afterAll() may run on different threads. the names are copied
+// as examples may run tmp_spec() with trees which are gone once the run is done.
+//
+
+class Tracer {
+    public:
+        explicit Tracer(int64_t epoch = now()) : generation(++generations), epoch(epoch) {}
+        static int64_t now() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+        // a span of a hook ("beforeEach", ...) in a group or of an example (hook is null)
+        void complete(const char* hook, const Item* item, int64_t begin, int64_t end) { record('X', hook, item, begin, end); }
+        void beginGroup(const ExampleGroup* group) { record('b', nullptr, group, now(), 0); }
+        void endGroup(const ExampleGroup* group) { record('e', nullptr, group, now(), 0); }
+        // the events recorded so far as JSON, e.g. to be sent from a worker to the parent
+        std::string take();
+        void append(std::string_view json);
+        bool write(const std::string& filename);
+        // a forked worker continues with a new tracer as the mutex of the inherited one
+        // may have been locked by another thread
+        static void forked();
+
+    private:
+        struct Event {
+                char phase;
+                const char* category;
+                std::string name, path;
+                uint64_t id;
+                int64_t begin, end;
+        };
+        struct Buffer {
+                unsigned tid;
+                std::vector<Event> events;
+        };
+        Buffer* buffer();
+        void record(char phase, const char* hook, const Item* item, int64_t begin, int64_t end);
+        std::string format(const Event& event, unsigned tid) const;
+
+        static inline std::atomic<uint64_t> generations = 0;
+        uint64_t generation;
+        int64_t epoch;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Buffer>> buffers;
+        std::string json;  // events taken from the buffers and received from workers
+};
+
+Tracer::Buffer* Tracer::buffer() {
+    // the generation tells a new tracer at the address of an old one apart
+    static thread_local uint64_t owner = 0;
+    static thread_local Buffer* local = nullptr;
+    if (owner != generation) {
+        std::lock_guard lock(mutex);
+        buffers.push_back(std::make_unique<Buffer>(static_cast<unsigned>(buffers.size())));
+        local = buffers.back().get();
+        owner = generation;
+    }
+    return local;
+}
+
+void Tracer::record(char phase, const char* hook, const Item* item, int64_t begin, int64_t end) {
+    auto category = phase != 'X' ? "group" : hook ? "hook" : "example";
+    auto name = hook ? hook : item->parent ? item->name : "(root)";
+    buffer()->events.push_back({phase, category, name, item->parent ? item->path() : "", item->m_id, begin, end});
+}
+
+std::string Tracer::format(const Event& event, unsigned tid) const {
+    auto us = [this](int64_t time) { return (time - epoch) / 1000.0; };
+    if (event.phase == 'X') {
+        return std::format("{{\"name\":{},\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":{},\"tid\":{},\"args\":{{\"path\":{}}}}},\n",
+                           escapeJson(event.name), event.category, us(event.begin), (event.end - event.begin) / 1000.0, getpid(), tid, escapeJson(event.path));
+    }
+    return std::format("{{\"name\":{},\"cat\":\"{}\",\"ph\":\"{}\",\"id\":\"{:x}\",\"ts\":{:.3f},\"pid\":{},\"tid\":{},\"args\":{{\"path\":{}}}}},\n",
+                       escapeJson(event.name), event.category, event.phase, event.id, us(event.begin), getpid(), tid, escapeJson(event.path));
+}
+
+std::string Tracer::take() {
+    std::lock_guard lock(mutex);
+    std::string result;
+    result.swap(json);
+    for (auto& buffer : buffers) {
+        for (auto& event : buffer->events) {
+            result += format(event, buffer->tid);
+        }
+        buffer->events.clear();
+    }
+    return result;
+}
+
+void Tracer::append(std::string_view events) {
+    std::lock_guard lock(mutex);
+    json += events;
+}
+
+void Tracer::forked() {
+    if (!currentTracer) {
+        return;
+    }
+    currentTracer = new Tracer(currentTracer->epoch);  // lives until the worker exits
+    currentTracer->json = std::format("{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},\"args\":{{\"name\":\"worker {}\"}}}},\n", getpid(), getpid());
+}
+
+bool Tracer::write(const std::string& filename) {
+    auto out = BufferedWriter::open(filename);
+    if (!out) {
+        return false;
+    }
+    *out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    *out << std::format("{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},\"args\":{{\"name\":\"kaffeeklatsch\"}}}},\n", getpid());
+    *out << take();
+    // JSON doesn't allow a trailing comma, hence end with an event which is always there
+    *out << std::format("{{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":{},\"args\":{{\"sort_index\":0}}}}\n]}}\n", getpid());
+    return true;
+}
+
+// records the span of a hook or an example when tracing
+class Span {
+    public:
+        Span(const char* hook, const Item* item) : tracer(currentTracer), hook(hook), item(item), begin(tracer ? Tracer::now() : 0) {}
+        ~Span() {
+            if (tracer) {
+                tracer->complete(hook, item, begin, Tracer::now());
+            }
+        }
+
+    private:
+        Tracer* tracer;
+        const char* hook;
+        const Item* item;
+        int64_t begin;
+};
+
+//
+// sequencer
+//
+// passes the results to the reporter in declaration order. a cursor walks the
+// tree and stops at the first item which isn't finished yet, each update moves
+// it as far as possible. hence the output is incremental while the examples may
+// be evaluated in any order, e.g. on a pool or in forked workers.
+//
+
+class Sequencer {
+    public:
+        Sequencer(ExampleGroup* root, Reporter* reporter) : root(root), reporter(reporter) {}
+        // call after an item was started or finished
+        void update();
+
+    private:
+        struct Frame {
+                ExampleGroup* group;
+                size_t next;
+        };
+        void enter(ExampleGroup* group);
+        ExampleGroup* root;
+        Reporter* reporter;
+        std::mutex mutex;
+        std::vector<Frame> stack;
+        bool entered = false;
+};
+
+void Sequencer::enter(ExampleGroup* group) {
+    if (reporter) {
+        reporter->beginGroup(group);
+        if (group->beforeAllError) {
+            reporter->hookFailed(group, "beforeAll", *group->beforeAllError);
+        }
+    }
+    stack.push_back({group, 0});
+}
+
+void Sequencer::update() {
+    std::lock_guard lock(mutex);
+    if (!entered) {
+        if (!root->m_started) {
+            return;
+        }
+        entered = true;
+        enter(root);
+    }
+    while (!stack.empty()) {
+        auto& frame = stack.back();
+        auto group = frame.group;
+        while (frame.next < group->items.size() && !group->selected(group->items[frame.next].get())) {
+            ++frame.next;
+        }
+        if (frame.next == group->items.size()) {
+            if (!group->m_finished) {
+                return;
+            }
+            if (reporter) {
+                if (group->afterAllError) {
+                    reporter->hookFailed(group, "afterAll", *group->afterAllError);
+                }
+                reporter->endGroup(group);
+            }
+            stack.pop_back();
+            continue;
+        }
+        auto item = group->items[frame.next].get();
+        if (auto child = dynamic_cast<ExampleGroup*>(item)) {
+            if (!child->m_started) {
+                return;
+            }
+            ++frame.next;
+            enter(child);
+            continue;
+        }
+        if (!item->m_finished) {
+            return;
+        }
+        ++frame.next;
+        auto example = static_cast<Example*>(item);
+        if (reporter) {
+            reporter->beginExample(example);
+            reporter->endExample(example);
+        }
+        // the result stays in the tree for the timings and status files but
+        // whatever the body captured can go
+        example->body = nullptr;
+    }
+}
+
+Reporter::~Reporter() {}
+
+namespace {
+
+// run the function and return what it threw
+std::optional<assertion_error> capture(const std::function<void()>& function) {
+    try {
+        function();
+    } catch (assertion_error const& ex) {
+        return ex;
+    } catch (std::exception const& ex) {
+        return assertion_error(ex.what(), "unknown", 0);
+    } catch (...) {
+        return assertion_error("catch all", "unknown", 0);
+    }
+    return std::nullopt;
+}
+
+std::optional<assertion_error> runHooks(const ExampleGroup* group, const char* name, const std::vector<std::function<void()>>& hooks) {
+    if (hooks.empty()) {
+        return std::nullopt;
+    }
+    Span span(name, group);
+    for (auto& hook : hooks) {
+        if (auto error = capture(hook)) {
+            return error;
+        }
+    }
+    return std::nullopt;
+}
+
+// the examples below a group whose beforeAll() failed are failed without evaluating them
+void failExamples(ExampleGroup* group, const assertion_error& cause, Statistics* statistics, Sequencer* sequencer) {
+    for (auto& item : group->items) {
+        if (!group->selected(item.get())) {
+            continue;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            ++statistics->numTotalTestSuites;
+            child->m_started = true;
+            failExamples(child, cause, statistics, sequencer);
+            child->m_finished = true;
+        } else {
+            auto example = static_cast<Example*>(item.get());
+            example->passed = false;
+            example->error = assertion_error(std::format("beforeAll() failed: {}", cause.what()), cause.filename, cause.line);
+            example->record(statistics);
+            example->m_finished = true;
+        }
+    }
+    sequencer->update();
+}
+
+// in forked workers the hooks run in the workers
+void startGroups(ExampleGroup* group) {
+    group->m_started = true;
+    group->m_finished = true;
+    for (auto& item : group->items) {
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            startGroups(child);
+        }
+    }
+}
+
+}  // namespace
+
+//
+// watchdog
+//
+// examples register their deadline in a slot of the thread they are running on,
+// which costs a few atomic increments. the watchdog thread checks the slots every few
+// milliseconds and warns about examples which are stuck. the example itself is failed
+// once it returns, as a thread can't be stopped safely. when it doesn't return within
+// the grace period, the run is ended with a backtrace of where it was stuck. in forked
+// workers the parent kills the worker instead (see --isolate).
+//
+
+namespace {
+
+std::string formatTimeout(std::chrono::nanoseconds timeout) {
+    if (timeout % 1ms == 0ns) {
+        return std::format("{}", std::chrono::duration_cast<std::chrono::milliseconds>(timeout));
+    }
+    return std::format("{}", std::chrono::duration_cast<std::chrono::microseconds>(timeout));
+}
+
+int64_t now() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+
+// when a worker exceeds the timeout the parent sends SIGUSR1 to get a backtrace
+// written to the traces pipe before killing it, in-process it goes to stderr
+int traceFd = STDERR_FILENO;
+
+void writeBacktrace(int) {
+    void* frames[64];
+    auto size = backtrace(frames, 64);
+    backtrace_symbols_fd(frames, size, traceFd);
+}
+
+// the example and it's deadline are written between two increments of seq, an odd seq
+// marks a write in progress, so that the watchdog sees them only as a pair. the watchdog
+// claims a stuck example by adding 2 to seq, which makes the guard wait for it
+struct WatchdogSlot {
+        std::atomic<uint64_t> seq = 0;
+        std::atomic<Example*> example = nullptr;
+        std::atomic<int64_t> deadline = 0;  // steady_clock
+        pthread_t thread;
+        // returns seq before and after the write
+        std::pair<uint64_t, uint64_t> publish(Example* running, int64_t until) {
+            auto before = seq.fetch_add(1);
+            example = running;
+            deadline = until;
+            return {before, seq.fetch_add(1) + 1};
+        }
+};
+
+class Watchdog {
+    public:
+        static Watchdog& instance() {
+            static Watchdog watchdog;
+            if (watchdog.pid == getpid()) {
+                return watchdog;
+            }
+            // a forked child has neither the parent's thread nor a consistent mutex. it's
+            // watchdog is never destroyed, the child ends with _exit()
+            static Watchdog* forked = nullptr;
+            if (!forked || forked->pid != getpid()) {
+                forked = new Watchdog;
+            }
+            return *forked;
+        }
+        ~Watchdog() {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        void add(WatchdogSlot* slot) {
+            std::lock_guard lock(mutex);
+            slots.push_back(slot);
+            if (!thread.joinable()) {
+                thread = std::thread([this] { loop(); });
+            }
+        }
+        void remove(WatchdogSlot* slot) {
+            std::lock_guard lock(mutex);
+            std::erase(slots, slot);
+            claims.erase(slot);
+        }
+        void sync() { std::lock_guard lock(mutex); }
+        // forked workers are killed by the parent instead, children forked by their examples aren't
+        static inline pid_t disabledIn = 0;
+        static inline std::atomic<int64_t> grace = std::chrono::nanoseconds(std::chrono::seconds(10)).count();
+
+    private:
+        struct Claim {
+                uint64_t seq = 0;
+                std::string path;
+        };
+        void loop() {
+            void* frames[1];
+            backtrace(frames, 1);  // the first call may allocate, which must not happen in a signal handler
+            std::unique_lock lock(mutex);
+            while (!wakeup.wait_for(lock, 10ms, [this] { return stopping; })) {
+                for (auto slot : slots) {
+                    auto seq = slot->seq.load();
+                    auto example = slot->example.load();
+                    auto deadline = slot->deadline.load();
+                    if (seq % 2 != 0 || slot->seq.load() != seq || !example || now() <= deadline) {
+                        continue;
+                    }
+                    auto& claim = claims[slot];
+                    if (claim.seq != seq) {
+                        if (!slot->seq.compare_exchange_strong(seq, seq + 2)) {
+                            continue;  // the example returned meanwhile
+                        }
+                        claim = {seq + 2, example->path()};
+                        std::println(stderr, "kaffeeklatsch: '{}' exceeded it's timeout of {}", claim.path, formatTimeout(*example->m_timeout));
+                    } else if (now() > deadline + grace) {
+                        std::println(stderr, "kaffeeklatsch: '{}' didn't return within {} after it's timeout, ending the run", claim.path,
+                                     formatTimeout(std::chrono::nanoseconds(grace)));
+                        traceFd = STDERR_FILENO;
+                        signal(SIGUSR1, writeBacktrace);
+                        pthread_kill(slot->thread, SIGUSR1);
+                        std::this_thread::sleep_for(100ms);  // for the backtrace to be written
+                        _exit(EXIT_FAILURE);
+                    }
+                }
+            }
+        }
+        pid_t pid = getpid();
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::vector<WatchdogSlot*> slots;
+        std::unordered_map<WatchdogSlot*, Claim> claims;  // the stuck examples already warned about
+        std::thread thread;
+        bool stopping = false;
+};
+
+struct ThreadSlot {
+        WatchdogSlot slot;
+        pid_t registered = 0;  // the process whose watchdog checks the slot
+        ~ThreadSlot() {
+            if (registered == getpid()) {
+                Watchdog::instance().remove(&slot);
+            }
+        }
+};
+
+// arms the watchdog for the duration of an example, restoring the example it
+// interrupted, e.g. when running tmp_spec()
+class WatchdogGuard {
+    public:
+        WatchdogGuard(Example* example) {
+            if (Watchdog::disabledIn == getpid() || !example->m_timeout || *example->m_timeout == 0ns) {
+                return;
+            }
+            static thread_local ThreadSlot threadSlot;
+            if (threadSlot.registered != getpid()) {
+                threadSlot.slot.thread = pthread_self();
+                Watchdog::instance().add(&threadSlot.slot);
+                threadSlot.registered = getpid();
+            }
+            slot = &threadSlot.slot;
+            previousExample = slot->example;
+            previousDeadline = slot->deadline;
+            armed = slot->publish(example, now() + example->m_timeout->count()).second;
+        }
+        ~WatchdogGuard() {
+            if (!slot) {
+                return;
+            }
+            // the watchdog claimed the example before printing it's path, wait for it to finish
+            if (slot->publish(previousExample, previousDeadline).first != armed) {
+                Watchdog::instance().sync();
+            }
+        }
+
+    private:
+        WatchdogSlot* slot = nullptr;
+        Example* previousExample = nullptr;
+        int64_t previousDeadline = 0;
+        uint64_t armed = 0;
+};
+
+// resolve the inherited timeouts
+void assignTimeouts(ExampleGroup* group, std::chrono::nanoseconds timeout) {
+    for (auto& item : group->items) {
+        if (!item->m_timeout) {
+            item->m_timeout = timeout;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            assignTimeouts(child, *item->m_timeout);
+        }
+    }
+}
+
+}  // namespace
+
+//
+// process isolation
+//
+// the tree is flattened into the list of selected examples and handed out by their
+// index to a pool of forked, persistent workers. a worker enters and leaves the
+// groups of the examples it receives, running their beforeAll()/afterAll() once per
+// worker. a worker which dies is recorded as a failure of it's current example and
+// respawned.
+//
+
+namespace {
+
+struct ResultHeader {
+        uint32_t id;
+        uint8_t passed;
+        uint8_t skipped;
+        int64_t duration;
+        uint32_t line;
+        uint32_t filenameSize;
+        uint32_t whatSize;
+        uint32_t traceSize;  // the worker's spans when tracing
+        uint32_t snapshots;
+        uint32_t recordedSize;  // the snapshots the example recorded, see SnapshotStore::takeRecorded()
+        Benchmark benchmark;
+        Resources resources;
+        Counters counters;
+};
+
+// the id of a message with only spans, sent by the worker before exiting
+constexpr uint32_t traceOnly = std::numeric_limits<uint32_t>::max();
+
+bool writeAll(int fd, const void* data, size_t size) {
+    auto ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        auto n = ::write(fd, ptr, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool readAll(int fd, void* data, size_t size) {
+    auto ptr = static_cast<char*>(data);
+    while (size > 0) {
+        auto n = ::read(fd, ptr, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+// assertion_error::filename must outlive the error
+const char* intern(const std::string& filename) {
+    static std::set<std::string> filenames;
+    return filenames.insert(filename).first->c_str();
+}
+
+void collectExamples(ExampleGroup* group, std::vector<Example*>* examples, unsigned* numGroups) {
+    ++*numGroups;
+    for (auto& item : group->items) {
+        if (!group->selected(item.get())) {
+            continue;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            collectExamples(child, examples, numGroups);
+        } else {
+            examples->push_back(static_cast<Example*>(item.get()));
+        }
+    }
+}
+
+// keeps track of the groups a worker has entered
+class GroupStack {
+    public:
+        void enter(ExampleGroup* group) {
+            std::vector<ExampleGroup*> path;
+            for (; group; group = group->parent) {
+                path.insert(path.begin(), group);
+            }
+            size_t common = 0;
+            while (common < entered.size() && common < path.size() && entered[common] == path[common]) {
+                ++common;
+            }
+            while (entered.size() > common) {
+                leaveLast();
+            }
+            for (size_t i = common; i < path.size(); ++i) {
+                entered.push_back(path[i]);
+                if (currentTracer) {
+                    currentTracer->beginGroup(path[i]);
+                }
+                if (auto error = runHooks(path[i], "beforeAll", path[i]->beforeAll)) {
+                    throw *error;
+                }
+            }
+        }
+        void leaveAll() {
+            while (!entered.empty()) {
+                leaveLast();
+            }
+        }
+
+    private:
+        void leaveLast() {
+            auto group = entered.back();
+            entered.pop_back();
+            auto error = runHooks(group, "afterAll", group->afterAll);
+            if (currentTracer) {
+                currentTracer->endGroup(group);
+            }
+            if (error) {
+                throw *error;
+            }
+        }
+        std::vector<ExampleGroup*> entered;
+};
+
+// read a message from a worker and pass it's spans on to the tracer
+bool readResult(int fd, ResultHeader* header, std::string* filename, std::string* what, std::string* recorded) {
+    std::string trace;
+    if (!readAll(fd, header, sizeof(*header)) || !readAll(fd, filename->assign(header->filenameSize, '\0').data(), header->filenameSize) ||
+        !readAll(fd, what->assign(header->whatSize, '\0').data(), header->whatSize) ||
+        !readAll(fd, trace.assign(header->traceSize, '\0').data(), header->traceSize) ||
+        !readAll(fd, recorded->assign(header->recordedSize, '\0').data(), header->recordedSize)) {
+        return false;
+    }
+    if (currentTracer) {
+        currentTracer->append(trace);
+    }
+    return true;
+}
+
+[[noreturn]] void workerMain(const std::vector<Example*>& examples, int commands, int results, int traces) {
+    Watchdog::disabledIn = getpid();
+    traceFd = traces;
+    void* frames[1];
+    backtrace(frames, 1);  // the first call may allocate, which must not happen in a signal handler
+    signal(SIGUSR1, writeBacktrace);
+    Tracer::forked();
+    GroupStack groups;
+    uint32_t id;
+    while (readAll(commands, &id, sizeof(id))) {
+        auto example = examples[id];
+        try {
+            groups.enter(example->parent);
+            example->execute();
+        } catch (assertion_error const& ex) {
+            example->passed = false;
+            example->error = assertion_error(std::format("beforeAll/afterAll: {}", ex.what()), ex.filename, ex.line);
+        } catch (std::exception const& ex) {
+            example->passed = false;
+            example->error = assertion_error(std::format("beforeAll/afterAll: {}", ex.what()), "unknown", 0);
+        } catch (...) {
+            example->passed = false;
+            example->error = assertion_error("beforeAll/afterAll: catch all", "unknown", 0);
+        }
+        std::string filename = example->passed ? "" : example->error.filename;
+        std::string what = example->passed ? "" : example->error.what();
+        std::string trace = currentTracer ? currentTracer->take() : "";
+        std::string recorded = example->m_snapshots ? example->m_snapshots->takeRecorded() : "";
+        ResultHeader header{id,
+                            example->passed,
+                            example->skipped,
+                            example->duration.count(),
+                            example->passed ? 0 : example->error.line,
+                            static_cast<uint32_t>(filename.size()),
+                            static_cast<uint32_t>(what.size()),
+                            static_cast<uint32_t>(trace.size()),
+                            example->snapshots,
+                            static_cast<uint32_t>(recorded.size()),
+                            example->benchmark,
+                            example->resources,
+                            example->counters};
+        std::string message(reinterpret_cast<const char*>(&header), sizeof(header));
+        message += filename;
+        message += what;
+        message += trace;
+        message += recorded;
+        fflush(nullptr);
+        if (!writeAll(results, message.data(), message.size())) {
+            break;
+        }
+    }
+    try {
+        groups.leaveAll();
+    } catch (...) {
+    }
+    if (currentTracer) {
+        // the spans of the afterAll() hooks
+        std::string trace = currentTracer->take();
+        ResultHeader header{traceOnly, 0, 0, 0, 0, 0, 0, static_cast<uint32_t>(trace.size()), 0, 0, {}, {}, {}};
+        std::string message(reinterpret_cast<const char*>(&header), sizeof(header));
+        message += trace;
+        writeAll(results, message.data(), message.size());
+    }
+    fflush(nullptr);
+    _exit(0);
+}
+
+struct Worker {
+        pid_t pid = -1;
+        int commands = -1;  // write end
+        int results = -1;   // read end
+        int traces = -1;    // read end
+        int64_t current = -1;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+void closeWorker(Worker* worker) {
+    for (auto fd : {worker->commands, worker->results, worker->traces}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    worker->commands = worker->results = worker->traces = -1;
+}
+
+void spawnWorker(Worker* worker, const std::vector<Worker>& workers, const std::vector<Example*>& examples) {
+    int commands[2], results[2], traces[2];
+    if (pipe(commands) != 0 || pipe(results) != 0 || pipe(traces) != 0) {
+        throw std::runtime_error(std::format("kaffeeklatsch: pipe() failed: {}", strerror(errno)));
+    }
+    fflush(nullptr);
+    auto pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error(std::format("kaffeeklatsch: fork() failed: {}", strerror(errno)));
+    }
+    if (pid == 0) {
+        for (auto& other : workers) {
+            for (auto fd : {other.commands, other.results, other.traces}) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        }
+        close(commands[1]);
+        close(results[0]);
+        close(traces[0]);
+        workerMain(examples, commands[0], results[1], traces[1]);
+    }
+    close(commands[0]);
+    close(results[1]);
+    close(traces[1]);
+    worker->pid = pid;
+    worker->commands = commands[1];
+    worker->results = results[0];
+    worker->traces = traces[0];
+    worker->current = -1;
+}
+
+// ask the worker for a backtrace, then kill it
+std::string killStuckWorker(Worker* worker) {
+    kill(worker->pid, SIGUSR1);
+    pollfd fd{worker->traces, POLLIN, 0};
+    poll(&fd, 1, 200);
+    usleep(10000);  // give backtrace_symbols_fd() a moment to finish
+    kill(worker->pid, SIGKILL);
+    waitpid(worker->pid, nullptr, 0);
+    worker->pid = -1;
+    std::string trace;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(worker->traces, buffer, sizeof(buffer))) > 0) {
+        trace.append(buffer, n);
+    }
+    closeWorker(worker);
+    return trace;
+}
+
+std::string describeExit(int status) {
+    if (WIFSIGNALED(status)) {
+        return std::format("worker terminated by signal {} ({})", WTERMSIG(status), strsignal(WTERMSIG(status)));
+    }
+    if (WIFEXITED(status)) {
+        return std::format("worker exited with status {}", WEXITSTATUS(status));
+    }
+    return "worker died";
+}
+
+}  // namespace
+
+void evaluateIsolated(ExampleGroup* root, Statistics* statistics, Sequencer* sequencer, unsigned jobs) {
+    std::vector<Example*> all, examples;
+    unsigned numGroups = 0;
+    collectExamples(root, &all, &numGroups);
+    statistics->numTotalTestSuites += numGroups;
+    startGroups(root);
+    for (auto example : all) {
+        if (example->m_skip) {
+            example->skipped = true;
+            example->record(statistics);
+            example->m_finished = true;
+        } else {
+            examples.push_back(example);
+        }
+    }
+    sequencer->update();
+
+    auto previousSigpipe = signal(SIGPIPE, SIG_IGN);
+    std::vector<Worker> workers(std::min<size_t>(jobs, examples.size()));
+    size_t next = 0, finished = 0;
+
+    auto dispatch = [&](Worker* worker) {
+        if (next >= examples.size()) {
+            // EOF tells the worker to run afterAll() and exit, it's results are read until it did
+            if (worker->commands >= 0) {
+                close(worker->commands);
+                worker->commands = -1;
+            }
+            return;
+        }
+        if (worker->pid < 0) {
+            spawnWorker(worker, workers, examples);
+        }
+        uint32_t id = next++;
+        worker->current = id;
+        auto timeout = examples[id]->m_timeout.value_or(0ns);
+        worker->deadline = timeout == 0ns ? std::chrono::steady_clock::time_point::max() : std::chrono::steady_clock::now() + timeout;
+        if (!writeAll(worker->commands, &id, sizeof(id))) {
+            // the worker died while idle, it's crash will be noticed when reading the results
+        }
+    };
+    auto complete = [&](Example* example) {
+        example->record(statistics);
+        example->m_finished = true;
+        sequencer->update();
+        ++finished;
+    };
+
+    for (auto& worker : workers) {
+        dispatch(&worker);
+    }
+    while (finished < examples.size()) {
+        std::vector<pollfd> fds;
+        std::vector<Worker*> polled;
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        for (auto& worker : workers) {
+            if (worker.results >= 0) {
+                fds.push_back({worker.results, POLLIN, 0});
+                polled.push_back(&worker);
+                if (worker.current >= 0) {
+                    deadline = std::min(deadline, worker.deadline);
+                }
+            }
+        }
+        int wait = -1;
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            wait = std::max<int>(0, left.count());
+        }
+        auto ready = poll(fds.data(), fds.size(), wait);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::format("kaffeeklatsch: poll() failed: {}", strerror(errno)));
+        }
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            auto worker = polled[i];
+            ResultHeader header;
+            std::string filename, what, recorded;
+            if (readResult(worker->results, &header, &filename, &what, &recorded)) {
+                if (header.id == traceOnly) {
+                    continue;
+                }
+                auto example = examples[header.id];
+                example->passed = header.passed;
+                example->skipped = header.skipped;
+                example->duration = std::chrono::nanoseconds(header.duration);
+                example->benchmark = header.benchmark;
+                example->resources = header.resources;
+                example->counters = header.counters;
+                example->snapshots = header.snapshots;
+                if (example->m_snapshots && !recorded.empty()) {
+                    example->m_snapshots->addRecorded(recorded);
+                }
+                if (!example->passed) {
+                    example->error = assertion_error(what, intern(filename), header.line);
+                }
+                worker->current = -1;
+                complete(example);
+                dispatch(worker);
+                continue;
+            }
+            // the worker crashed
+            int status = 0;
+            closeWorker(worker);
+            waitpid(worker->pid, &status, 0);
+            worker->pid = -1;
+            if (worker->current >= 0) {
+                auto example = examples[worker->current];
+                example->passed = false;
+                example->error = assertion_error(describeExit(status), "unknown", 0);
+                worker->current = -1;
+                complete(example);
+            }
+            dispatch(worker);
+        }
+        // checked on every pass as poll() may never time out while other workers keep sending results
+        auto current = std::chrono::steady_clock::now();
+        for (auto& worker : workers) {
+            if (worker.current >= 0 && worker.deadline <= current) {
+                auto example = examples[worker.current];
+                auto trace = killStuckWorker(&worker);
+                example->passed = false;
+                example->duration = current - (worker.deadline - *example->m_timeout);
+                example->error = assertion_error(std::format("timeout of {} exceeded, worker killed{}{}", formatTimeout(*example->m_timeout),
+                                                             trace.empty() ? "" : " while at\n", trace),
+                                                 "unknown", 0);
+                worker.current = -1;
+                complete(example);
+                dispatch(&worker);
+            }
+        }
+    }
+    for (auto& worker : workers) {
+        ResultHeader header;
+        std::string filename, what, recorded;
+        while (worker.results >= 0 && readResult(worker.results, &header, &filename, &what, &recorded)) {
+        }
+        closeWorker(&worker);
+        if (worker.pid >= 0) {
+            waitpid(worker.pid, nullptr, 0);
+        }
+    }
+    signal(SIGPIPE, previousSigpipe);
+}
+
+//
+// sharding
+//
+// the selected examples are split into units which are distributed over the shards
+// by longest processing time first. a group with beforeAll()/afterAll() is a single
+// unit so that it's fixture is only set up on one shard, except for the root, whose
+// hooks run on every shard. the costs and the declaration order, which breaks ties,
+// must be the same for all shards for them to be disjoint.
+//
+
+namespace {
+
+struct Unit {
+        Item* item;
+        double cost;
+};
+
+double collectCost(ExampleGroup* group, const std::function<double(const Example*)>& cost) {
+    double sum = 0;
+    for (auto& item : group->items) {
+        if (!group->selected(item.get())) {
+            continue;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            sum += collectCost(child, cost);
+        } else if (!item->m_skip) {
+            sum += cost(static_cast<Example*>(item.get()));
+        }
+    }
+    return sum;
+}
+
+void collectUnits(ExampleGroup* group, const std::function<double(const Example*)>& cost, std::vector<Unit>* units) {
+    for (auto& item : group->items) {
+        if (!group->selected(item.get())) {
+            continue;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            if (!child->beforeAll.empty() || !child->afterAll.empty()) {
+                units->push_back({child, collectCost(child, cost)});
+            } else {
+                collectUnits(child, cost, units);
+            }
+        } else {
+            units->push_back({item.get(), item->m_skip ? 0 : cost(static_cast<Example*>(item.get()))});
+        }
+    }
+}
+
+void filterExamples(ExampleGroup* group, const std::function<bool(const Example*)>& keep) {
+    for (auto& item : group->items) {
+        if (!group->selected(item.get())) {
+            continue;
+        }
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get())) {
+            filterExamples(child, keep);
+        } else if (!keep(static_cast<Example*>(item.get()))) {
+            item->m_filtered = true;
+        }
+    }
+}
+
+// filter groups which had children but have none left
+void pruneFiltered(ExampleGroup* group) {
+    bool hadChildren = false, hasChildren = false;
+    for (auto& item : group->items) {
+        if (!group->focused(item.get())) {
+            continue;
+        }
+        hadChildren = true;
+        if (auto child = dynamic_cast<ExampleGroup*>(item.get()); child && !child->m_filtered) {
+            pruneFiltered(child);
+        }
+        hasChildren = hasChildren || !item->m_filtered;
+    }
+    if (hadChildren && !hasChildren && group->parent) {
+        group->m_filtered = true;
+    }
+}
+
+}  // namespace
+
+//
+// path and name filters
+//
+
+std::vector<std::string> splitPath(std::string_view path) {
+    std::vector<std::string> names;
+    while (true) {
+        auto separator = path.find(" > ");
+        names.emplace_back(path.substr(0, separator));
+        if (separator == std::string_view::npos) {
+            return names;
+        }
+        path.remove_prefix(separator + 3);
+    }
+}
+
+namespace {
+
+std::vector<std::string> namesOf(const Item* item) {
+    std::vector<std::string> names;
+    for (; item->parent; item = item->parent) {
+        names.insert(names.begin(), item->name);
+    }
+    return names;
+}
+
+const ExampleGroup* rootOf(const ExampleGroup* group) {
+    while (group->parent) {
+        group = group->parent;
+    }
+    return group;
+}
+
+// whether names and path agree up to the shorter one of both
+bool onPath(const std::vector<std::string>& names, const std::vector<std::string>& path) {
+    auto n = std::min(names.size(), path.size());
+    return std::equal(names.begin(), names.begin() + n, path.begin());
+}
+
+}  // namespace
+
+// a group's body only needs to be executed when it is on one of the paths
+bool expandable(const ExampleGroup* group) {
+    auto root = rootOf(group);
+    if (root->m_paths.empty()) {
+        return true;
+    }
+    auto names = namesOf(group);
+    return std::any_of(root->m_paths.begin(), root->m_paths.end(), [&](auto& path) { return onPath(names, path); });
+}
+
+void filter(ExampleGroup* root, std::function<bool(const Example*)> keep) {
+    filterExamples(root, keep);
+    pruneFiltered(root);
+}
+
+void shard(ExampleGroup* root, unsigned shard, unsigned shards, std::function<double(const Example*)> cost) {
+    std::vector<Unit> units;
+    collectUnits(root, cost, &units);
+    std::vector<size_t> order(units.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return units[a].cost > units[b].cost; });
+    std::vector<double> load(shards, 0);
+    for (auto i : order) {
+        auto least = std::min_element(load.begin(), load.end()) - load.begin();
+        load[least] += units[i].cost;
+        if (static_cast<unsigned>(least) != shard - 1) {
+            units[i].item->m_filtered = true;
+        }
+    }
+    pruneFiltered(root);
+}
+
+void evaluate(ExampleGroup* root, Statistics* statistics, const Options& options, const TimingDatabase* timings) {
+    auto reporter = options.reporter;
+    root->scan();
+    assignTimeouts(root, root->m_timeout.value_or(options.timeout));
+    if (options.baselines) {
+        assignBaselines(root, *options.baselines, options.significance, options.regressionThreshold);
+    }
+    if (options.counters) {
+        enableCounters(root);
+    }
+    if (options.snapshotStore) {
+        assignSnapshots(root, options.snapshotStore);
+    }
+    if (options.seed) {
+        assignProperties(root, options.cases, *options.seed);
+    } else {
+        std::random_device random;
+        assignProperties(root, options.cases, (uint64_t(random()) << 32) | random());
+    }
+    bool hasTimings = timings && !timings->empty();
+    if (hasTimings) {
+        double sum = 0;
+        size_t count = 0;
+        collectHistory(root, *timings, &sum, &count);
+        estimate(root, count > 0 ? sum / count : 0);
+    }
+    if (!root->m_paths.empty() || !options.grep.empty()) {
+        std::regex re(options.grep);
+        filter(root, [&](const Example* example) {
+            if (!root->m_paths.empty()) {
+                auto names = namesOf(example);
+                if (!std::any_of(root->m_paths.begin(), root->m_paths.end(), [&](auto& path) { return names.size() >= path.size() && onPath(names, path); })) {
+                    return false;
+                }
+            }
+            return options.grep.empty() || std::regex_search(example->path(), re);
+        });
+    }
+    if (options.only) {
+        bool first = true;
+        filter(root, [&](const Example* example) {
+            if (!options.only->contains(example->m_id) || (options.onlyFirst && !first)) {
+                return false;
+            }
+            first = false;
+            return true;
+        });
+    }
+    if (options.shards > 1) {
+        shard(root, options.shard, options.shards, [hasTimings](const Example* example) { return hasTimings ? example->m_expected : 1.0; });
+    }
+    if (reporter) {
+        reporter->beginRun();
+    }
+    std::optional<Tracer> tracer;
+    auto previousTracer = currentTracer;
+    if (!options.trace.empty()) {
+        currentTracer = &tracer.emplace();
+    }
+    // when the root has beforeAll()/afterAll() the whole tree is a single unit of one shard
+    if (!root->m_filtered) {
+        Sequencer sequencer(root, reporter);
+        if (options.isolate) {
+            evaluateIsolated(root, statistics, &sequencer, std::max(1u, options.jobs));
+        } else if (options.jobs <= 1) {
+            root->evaluate(statistics, &sequencer);
+        } else {
+            ThreadPool pool(options.jobs);
+            root->schedule(&pool, &sequencer, [] {});
+            pool.wait();
+            pool.mergeStatistics(statistics);
+        }
+        --statistics->numTotalTestSuites;  // remove the root group
+    }
+    if (tracer) {
+        currentTracer = previousTracer;
+        if (!tracer->write(options.trace)) {
+            std::println(stderr, "kaffeeklatsch: failed to write '{}'", options.trace);
+        }
+    }
+    statistics->numTotalTests = statistics->numPassedTests + statistics->numSkippedTests + statistics->numFailedTests;
+    if (reporter) {
+        reporter->endRun(*statistics);
+    }
+}
+
+Item::~Item() {}
+
+void ExampleGroup::scan() {
+    std::unordered_map<std::string_view, unsigned> occurrences;
+    for (auto& item : items) {
+        // the n-th sibling with the same name
+        auto n = occurrences[item->name]++;
+        item->m_id = fnv1a(fnv1a(m_id ? m_id : 0xcbf29ce484222325ull, "\x1f"), item->name);
+        if (n > 0) {
+            item->m_id = fnv1a(item->m_id, std::format("#{}", n));
+        }
+        item->m_skip = item->m_skip || m_skip;
+        item->scan();
+        m_has_focus_child = m_has_focus_child || item->m_has_focus_child || item->m_focus;
+    }
+}
+
+void Example::scan() {}
+
+bool ExampleGroup::focused(const Item* item) const { return !m_has_focus_child || item->m_has_focus_child || item->m_focus; }
+bool ExampleGroup::selected(const Item* item) const { return !item->m_filtered && focused(item); }
+
+void ExampleGroup::evaluate(Statistics* statistics, Sequencer* sequencer) {
+    ++statistics->numTotalTestSuites;
+    if (currentTracer) {
+        currentTracer->beginGroup(this);
+    }
+    beforeAllError = runHooks(this, "beforeAll", beforeAll);
+    m_started = true;
+    sequencer->update();
+    if (beforeAllError) {
+        failExamples(this, *beforeAllError, statistics, sequencer);
+    } else {
+        for (auto& item : items) {
+            if (!selected(item.get())) {
+                continue;
+            }
+            item->evaluate(statistics, sequencer);
+        }
+    }
+    afterAllError = runHooks(this, "afterAll", afterAll);
+    if (currentTracer) {
+        currentTracer->endGroup(this);
+    }
+    m_finished = true;
+    sequencer->update();
+}
+
+namespace {
+
+// each item is scheduled once the one before it finished, the steps share the items
+void scheduleInOrder(std::shared_ptr<const std::vector<Item*>> items, size_t index, ThreadPool* pool, Sequencer* sequencer, std::function<void()> done) {
+    if (index == items->size()) {
+        done();
+        return;
+    }
+    auto item = (*items)[index];
+    item->schedule(pool, sequencer,
+                   [items = std::move(items), index, pool, sequencer, done = std::move(done)] { scheduleInOrder(items, index + 1, pool, sequencer, done); });
+}
+
+}  // namespace
+
+// beforeAll runs on the worker which picked up the group, afterAll on the worker
+// which finished the group's last child
+void ExampleGroup::schedule(ThreadPool* pool, Sequencer* sequencer, std::function<void()> done) {
+    pool->submit([this, pool, sequencer, done] {
+        ++pool->statistics().numTotalTestSuites;
+        if (currentTracer) {
+            currentTracer->beginGroup(this);
+        }
+        beforeAllError = runHooks(this, "beforeAll", beforeAll);
+        m_started = true;
+        sequencer->update();
+        std::vector<Item*> children;
+        if (beforeAllError) {
+            failExamples(this, *beforeAllError, &pool->statistics(), sequencer);
+        } else {
+            for (auto& item : items) {
+                if (selected(item.get())) {
+                    children.push_back(item.get());
+                }
+            }
+        }
+        auto finish = [this, sequencer, done] {
+            afterAllError = runHooks(this, "afterAll", afterAll);
+            if (currentTracer) {
+                currentTracer->endGroup(this);
+            }
+            m_finished = true;
+            sequencer->update();
+            done();
+        };
+        if (children.empty()) {
+            finish();
+            return;
+        }
+        if (m_serial) {
+            for (auto child : children) {
+                if (auto group = dynamic_cast<ExampleGroup*>(child)) {
+                    group->m_serial = true;
+                }
+            }
+            scheduleInOrder(std::make_shared<const std::vector<Item*>>(std::move(children)), 0, pool, sequencer, finish);
+            return;
+        }
+        // longest first
+        std::stable_sort(children.begin(), children.end(), [](Item* a, Item* b) { return a->m_expected > b->m_expected; });
+        pending = children.size();
+        for (auto child : children) {
+            child->schedule(pool, sequencer, [this, finish] {
+                if (--pending == 0) {
+                    finish();
+                }
+            });
+        }
+    });
+}
+
+void Example::evaluateBeforeEach(ExampleGroup *group) {
+    if (!group) {
+        return;
+    }
+    if (group->parent) {
+        evaluateBeforeEach(group->parent);
+    }
+    if (group->beforeEach.empty()) {
+        return;
+    }
+    Span span("beforeEach", group);
+    for (auto& call : group->beforeEach) {
+        call();
+    }
+}
+
+void Example::evaluateAfterEach(ExampleGroup *group) {
+    if (!group) {
+        return;
+    }
+    if (!group->afterEach.empty()) {
+        Span span("afterEach", group);
+        for (auto& call : group->afterEach) {
+            call();
+        }
+    }
+    if (group->parent) {
+        evaluateAfterEach(group->parent);
+    }
+}
+
+void Example::evaluate(Statistics* statistics, Sequencer* sequencer) {
+    execute();
+    record(statistics);
+    m_finished = true;
+    sequencer->update();
+}
+
+namespace {
+
+// RUSAGE_THREAD is linux only, elsewhere the process' usage is taken, which includes
+// that of the examples evaluated concurrently with --jobs
+#ifdef RUSAGE_THREAD
+constexpr int rusageWho = RUSAGE_THREAD;
+#else
+constexpr int rusageWho = RUSAGE_SELF;
+#endif
+#ifdef __APPLE__
+constexpr int64_t maxRssUnit = 1;
+#else
+constexpr int64_t maxRssUnit = 1024;
+#endif
+
+std::chrono::nanoseconds toNanoseconds(const timeval& time) { return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec); }
+
+class ResourceMeter {
+    public:
+        ResourceMeter() { getrusage(rusageWho, &begin); }
+        Resources elapsed() const {
+            rusage end;
+            getrusage(rusageWho, &end);
+            return {toNanoseconds(end.ru_utime) - toNanoseconds(begin.ru_utime),
+                    toNanoseconds(end.ru_stime) - toNanoseconds(begin.ru_stime),
+                    (end.ru_maxrss - begin.ru_maxrss) * maxRssUnit,
+                    end.ru_minflt - begin.ru_minflt,
+                    end.ru_majflt - begin.ru_majflt,
+                    end.ru_nvcsw - begin.ru_nvcsw,
+                    end.ru_nivcsw - begin.ru_nivcsw};
+        }
+
+    private:
+        rusage begin;
+};
+
+}  // namespace
+
+thread_local bool softwareEventsPermitted = true, hardwareEventsPermitted = true;
+
+namespace {
+
+#ifdef __linux__
+// a group of counters which is read at once, the first one leads. the counters run
+// from the start, an example takes the difference of two readings
+class PerfGroup {
+    public:
+        struct Reading {
+                uint64_t enabled = 0;  // times of the group
+                uint64_t running = 0;
+                std::vector<uint64_t> values;
+        };
+        PerfGroup(std::initializer_list<std::pair<uint32_t, uint64_t>> events, bool permitted);
+        ~PerfGroup();
+        bool valid() const { return fds.size() == size; }
+        Reading read() const;
+        // the values between the readings, scaled up for the time the kernel multiplexed them out
+        std::vector<uint64_t> delta(const Reading& begin, const Reading& end) const;
+
+    private:
+        size_t size;
+        std::vector<int> fds;
+};
+
+PerfGroup::PerfGroup(std::initializer_list<std::pair<uint32_t, uint64_t>> events, bool permitted) : size(events.size()) {
+    if (!permitted) {
+        return;
+    }
+    for (auto [type, config] : events) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, fds.empty() ? -1 : fds.front(), PERF_FLAG_FD_CLOEXEC);
+        if (fd < 0) {
+            for (auto open : fds) {
+                close(open);
+            }
+            fds.clear();
+            return;
+        }
+        fds.push_back(fd);
+    }
+}
+
+PerfGroup::~PerfGroup() {
+    for (auto fd : fds) {
+        close(fd);
+    }
+}
+
+PerfGroup::Reading PerfGroup::read() const {
+    Reading reading;
+    reading.values.resize(size);
+    if (!valid()) {
+        return reading;
+    }
+    std::vector<uint64_t> data(3 + size);  // number of values, time enabled, time running, values
+    if (::read(fds.front(), data.data(), data.size() * sizeof(uint64_t)) == ssize_t(data.size() * sizeof(uint64_t))) {
+        reading.enabled = data[1];
+        reading.running = data[2];
+        std::copy(data.begin() + 3, data.end(), reading.values.begin());
+    }
+    return reading;
+}
+
+std::vector<uint64_t> PerfGroup::delta(const Reading& begin, const Reading& end) const {
+    std::vector<uint64_t> values(size);
+    auto enabled = end.enabled - begin.enabled;
+    auto running = end.running - begin.running;
+    double scale = running > 0 && running < enabled ? double(enabled) / running : 1;
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = (end.values[i] - begin.values[i]) * scale;
+    }
+    return values;
+}
+
+// the counters of the calling thread, opened on first use
+class PerfCounters {
+    public:
+        struct Reading {
+                PerfGroup::Reading hardware;
+                PerfGroup::Reading software;
+        };
+        static PerfCounters& get() {
+            static thread_local std::unique_ptr<PerfCounters> counters;
+            // a forked worker would read the counters of the parent's thread
+            if (!counters || counters->pid != getpid() || counters->softwarePermitted != softwareEventsPermitted ||
+                counters->hardwarePermitted != hardwareEventsPermitted) {
+                counters.reset(new PerfCounters);
+            }
+            return *counters;
+        }
+        Reading read() const { return {hardware.read(), software.read()}; }
+        Counters since(const Reading& begin) const {
+            auto end = read();
+            Counters counters;
+            counters.hardware = hardware.valid();
+            counters.software = software.valid();
+            auto values = hardware.delta(begin.hardware, end.hardware);
+            counters.instructions = values[0];
+            counters.cycles = values[1];
+            counters.cacheMisses = values[2];
+            counters.branchMisses = values[3];
+            values = software.delta(begin.software, end.software);
+            counters.taskClock = std::chrono::nanoseconds(values[0]);
+            counters.pageFaults = values[1];
+            counters.contextSwitches = values[2];
+            return counters;
+        }
+
+    private:
+        pid_t pid = getpid();
+        bool softwarePermitted = softwareEventsPermitted, hardwarePermitted = hardwareEventsPermitted;
+        PerfGroup hardware{{{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}},
+                           hardwarePermitted};
+        PerfGroup software{{{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+                            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+                            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}},
+                           softwarePermitted};
+};
+#else
+// perf_event_open() is linux only
+class PerfCounters {
+    public:
+        struct Reading {};
+        static PerfCounters& get() {
+            static PerfCounters counters;
+            return counters;
+        }
+        Reading read() const { return {}; }
+        Counters since(const Reading&) const { return {}; }
+};
+#endif
+
+}  // namespace
+
+void Example::execute() {
+    WatchdogGuard watchdog(this);
+    Span span(nullptr, this);
+    ResourceMeter meter;
+    std::optional<PerfCounters::Reading> reading;
+    if (m_counters) {
+        reading = PerfCounters::get().read();
+    }
+    snapshots = 0;
+    auto previousExample = std::exchange(currentExample, this);
+    auto begin = std::chrono::high_resolution_clock::now();
+    auto thrown = capture([this] {
+        if (m_skip) {
+            skipped = true;
+        } else {
+            evaluateBeforeEach(parent);
+            if (m_bench) {
+                measure();
+            } else if (m_property) {
+                check();
+            } else {
+                body();
+            }
+            evaluateAfterEach(parent);
+        }
+    });
+    if (thrown) {
+        passed = false;
+        error = *thrown;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    currentExample = previousExample;
+    duration = end - begin;
+    resources = meter.elapsed();
+    if (reading) {
+        counters = PerfCounters::get().since(*reading);
+    }
+    if (passed && !skipped && m_timeout && *m_timeout != 0ns && duration > *m_timeout) {
+        passed = false;
+        error = assertion_error(std::format("timeout of {} exceeded", formatTimeout(*m_timeout)), "unknown", 0);
+    }
+    if (passed && !skipped && m_bench && !baseline.empty()) {
+        compareWithBaseline();
+    }
+}
+
+// a sample is long enough for the clock's resolution and the call overhead not to
+// matter while the samples are many enough to tell the noise
+void Example::measure() {
+    using clock = std::chrono::steady_clock;
+    constexpr auto warmup = 20ms;
+    constexpr auto sampleTime = 10ms;
+    constexpr unsigned numSamples = Benchmark::maxSamples;
+    auto run = [this](uint64_t iterations) {
+        auto begin = clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            body();
+        }
+        return clock::now() - begin;
+    };
+
+    // warm up caches and branch predictors while finding the iterations per sample
+    uint64_t iterations = 1;
+    auto begin = clock::now();
+    for (;;) {
+        auto elapsed = run(iterations);
+        if (elapsed < sampleTime / 10) {
+            iterations *= 2;
+            continue;
+        }
+        if (clock::now() - begin >= warmup) {
+            iterations = std::max<uint64_t>(1, iterations * (std::chrono::duration<double>(sampleTime) / elapsed));
+            break;
+        }
+    }
+
+    std::vector<double> samples;
+    for (unsigned i = 0; i < numSamples; ++i) {
+        samples.push_back(double(std::chrono::nanoseconds(run(iterations)).count()) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (auto sample : samples) {
+        sum += sample;
+    }
+    benchmark.iterations = iterations;
+    benchmark.samples = numSamples;
+    benchmark.mean = sum / numSamples;
+    benchmark.median = (samples[(numSamples - 1) / 2] + samples[numSamples / 2]) / 2;
+    benchmark.min = samples.front();
+    double variance = 0;
+    for (auto sample : samples) {
+        variance += (sample - benchmark.mean) * (sample - benchmark.mean);
+    }
+    benchmark.stddev = std::sqrt(variance / (numSamples - 1));
+    std::copy(samples.begin(), samples.end(), benchmark.values.begin());
+}
+
+uint64_t Choices::next() {
+    uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+uint64_t Choices::draw(uint64_t max) {
+    uint64_t choice = 0;
+    if (m_replaying) {
+        choice = m_drawn.size() < m_replay.size() ? std::min(m_replay[m_drawn.size()], max) : 0;
+    } else if (auto edge = next(); edge % 16 == 0) {
+        choice = edge & 16 ? max : 0;
+    } else if (max == std::numeric_limits<uint64_t>::max()) {
+        choice = next();
+    } else {
+        choice = static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * (max + 1)) >> 64);
+    }
+    m_drawn.push_back(choice);
+    return choice;
+}
+
+bool Choices::more() {
+    uint64_t choice = 0;
+    if (m_replaying) {
+        choice = m_drawn.size() < m_replay.size() && m_replay[m_drawn.size()] != 0;
+    } else {
+        // containers have size / 2 elements on average
+        choice = next() % (m_size + 2) < m_size;
+    }
+    m_drawn.push_back(choice);
+    return choice != 0;
+}
+
+namespace {
+
+enum class Outcome { passed, failed, rejected };
+
+Outcome evaluateCase(const std::function<void(Choices&, std::string*)>& property, Choices& choices, std::string* description, assertion_error* error) {
+    try {
+        property(choices, description);
+        return Outcome::passed;
+    } catch (Unsatisfiable const& ex) {
+        *error = assertion_error(ex.what(), "unknown", 0);
+        return Outcome::rejected;
+    } catch (assertion_error const& ex) {
+        *error = ex;
+    } catch (std::exception const& ex) {
+        *error = assertion_error(ex.what(), "unknown", 0);
+    } catch (...) {
+        *error = assertion_error("catch all", "unknown", 0);
+    }
+    return Outcome::failed;
+}
+
+// fewer choices or, with as many, smaller ones first
+bool simpler(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) { return a.size() != b.size() ? a.size() < b.size() : a < b; }
+
+}  // namespace
+
+// the cases are handed out to the threads in batches and once a case failed, the cases after it
+// are skipped. the first failing case is thus the same for any number of threads and is shrunk
+// by deleting chunks of it's choices and lowering each of them while it keeps failing. cases a
+// gen::filter() rejected are discarded and replaced by another one, up to 10 per case
+void Example::check() {
+    auto numCases = m_cases.value_or(100);
+    auto maxDiscards = 10 * uint64_t(numCases);
+    auto numThreads = std::min(m_threads != 0 ? m_threads : std::max(1u, std::thread::hardware_concurrency()), std::max(1u, numCases));
+    struct Failure {
+            uint64_t index;
+            std::vector<uint64_t> choices;
+            assertion_error error;
+            bool rejected;
+    };
+    std::mutex mutex;
+    std::optional<Failure> failure;
+    uint64_t discards = 0;
+    std::atomic<uint64_t> next = 0, limit = numCases;
+    auto evaluateCases = [&] {
+        constexpr uint64_t batch = 64;
+        for (;;) {
+            auto first = next.fetch_add(batch);
+            for (auto index = first; index < first + batch; ++index) {
+                if (index >= limit) {
+                    return;
+                }
+                Choices choices(m_seed ^ m_id ^ (index * 0xd1b54a32d192ed03ull), index % 100);
+                assertion_error thrown;
+                auto outcome = evaluateCase(m_property, choices, nullptr, &thrown);
+                if (outcome == Outcome::passed) {
+                    continue;
+                }
+                std::lock_guard lock(mutex);
+                if (outcome == Outcome::rejected && ++discards <= maxDiscards) {
+                    if (!failure) {
+                        ++limit;
+                    }
+                    continue;
+                }
+                if (!failure || index < failure->index) {
+                    failure = Failure{index, choices.drawn(), thrown, outcome == Outcome::rejected};
+                    limit = index;
+                }
+                return;
+            }
+        }
+    };
+    // the case threads run in the context of the example, shrinking continues on this thread
+    struct RestoreParallel {
+            bool previous;
+            ~RestoreParallel() { parallelCases = previous; }
+    } restoreParallel{std::exchange(parallelCases, numThreads > 1)};
+    {
+        std::vector<std::jthread> threads;
+        for (unsigned i = 1; i < numThreads; ++i) {
+            threads.emplace_back([&, suite = currentSuite] {
+                currentSuite = suite;
+                currentExample = this;
+                parallelCases = true;
+                evaluateCases();
+            });
+        }
+        evaluateCases();
+    }
+    if (!failure) {
+        return;
+    }
+    if (failure->rejected) {
+        throw assertion_error(std::format("gave up after {} discarded cases, {} (--seed={})", discards, failure->error.what(), m_seed), "unknown", 0);
+    }
+
+    constexpr unsigned maxAttempts = 10000;
+    auto best = std::move(failure->choices);
+    auto bestError = failure->error;
+    unsigned attempts = 0, shrinks = 0;
+    // adopt the candidate when it still fails with simpler choices
+    auto attempt = [&](std::vector<uint64_t> candidate) {
+        if (attempts++ >= maxAttempts) {
+            return false;
+        }
+        Choices choices(std::move(candidate));
+        assertion_error thrown;
+        if (evaluateCase(m_property, choices, nullptr, &thrown) != Outcome::failed || !simpler(choices.drawn(), best)) {
+            return false;
+        }
+        best = choices.drawn();
+        bestError = thrown;
+        ++shrinks;
+        return true;
+    };
+    for (bool improved = true; improved && attempts < maxAttempts;) {
+        improved = false;
+        for (size_t chunk = 8; chunk > 0; chunk /= 2) {
+            for (size_t i = 0; i + chunk <= best.size();) {
+                auto candidate = best;
+                candidate.erase(candidate.begin() + i, candidate.begin() + i + chunk);
+                if (attempt(std::move(candidate))) {
+                    improved = true;
+                } else {
+                    ++i;
+                }
+            }
+        }
+        for (size_t i = 0; i < best.size(); ++i) {
+            if (best[i] == 0) {
+                continue;
+            }
+            auto candidate = best;
+            candidate[i] = 0;
+            if (attempt(std::move(candidate))) {
+                improved = true;
+                continue;
+            }
+            // binary search for the smallest choice which still fails, lo passed
+            for (uint64_t lo = 0; i < best.size() && lo + 1 < best[i];) {
+                auto mid = lo + (best[i] - lo) / 2;
+                candidate = best;
+                candidate[i] = mid;
+                if (attempt(std::move(candidate))) {
+                    improved = true;
+                } else {
+                    lo = mid;
+                }
+            }
+        }
+    }
+
+    Choices choices(best);
+    std::string values;
+    assertion_error thrown;
+    evaluateCase(m_property, choices, &values, &thrown);
+    throw assertion_error(std::format("{} for ({}) (case {} shrunk {} times, --seed={})", bestError.what(), values, failure->index + 1, shrinks, m_seed),
+                          bestError.filename, bestError.line);
+}
+
+constinit thread_local Allocations allocations;
+bool allocationsTracked = false;
+
+std::optional<Allocations> countAllocations(const std::function<void()>& fn) {
+    if (!allocationsTracked) {
+        return {};
+    }
+    auto before = allocations;
+    fn();
+    return Allocations{allocations.count - before.count, allocations.bytes - before.bytes};
+}
+
+std::vector<std::chrono::nanoseconds> sampleLatencies(const std::function<void()>& fn, unsigned count) {
+    using clock = std::chrono::steady_clock;
+    fn();
+    std::vector<std::chrono::nanoseconds> durations;
+    durations.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        auto begin = clock::now();
+        fn();
+        durations.push_back(clock::now() - begin);
+    }
+    std::sort(durations.begin(), durations.end());
+    return durations;
+}
+
+std::string formatComplexity(Complexity complexity) {
+    switch (complexity) {
+        case Complexity::constant:
+            return "O(1)";
+        case Complexity::logarithmic:
+            return "O(log n)";
+        case Complexity::linear:
+            return "O(n)";
+        case Complexity::linearithmic:
+            return "O(n log n)";
+        case Complexity::quadratic:
+            return "O(n²)";
+    }
+    return "O(?)";
+}
+
+std::chrono::nanoseconds threadCpuTime() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+// the cpu time of the calling thread doesn't include the time it was preempted, e.g. by
+// examples running concurrently. the sizes are interleaved in rounds so that a slow
+// phase of the machine doesn't skew a single size, the fastest call of each is kept
+std::vector<double> measureScaling(const std::vector<size_t>& sizes, const std::function<void(size_t)>& fn, bool countingAllocations) {
+    std::vector<double> values;
+    if (countingAllocations) {
+        for (auto size : sizes) {
+            fn(size);  // warm up
+            values.push_back(countAllocations([&] { fn(size); }).value_or(Allocations()).count);
+        }
+        return values;
+    }
+    std::vector<std::chrono::nanoseconds> fastest(sizes.size(), std::chrono::nanoseconds::max());
+    std::chrono::nanoseconds total{};
+    for (unsigned round = 0; round < 1000 && (round < 5 || total < 50ms); ++round) {
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            auto begin = threadCpuTime();
+            fn(sizes[i]);
+            auto elapsed = threadCpuTime() - begin;
+            fastest[i] = std::min(fastest[i], elapsed);
+            total += elapsed;
+        }
+    }
+    for (auto duration : fastest) {
+        values.push_back(duration.count());
+    }
+    return values;
+}
+
+// as in google benchmark's ComputeBigO(), without a constant term for the overhead
+std::array<double, 5> fitComplexity(const std::vector<size_t>& sizes, const std::vector<double>& values) {
+    std::array<double, 5> errors = {};
+    double mean = 0;
+    for (auto value : values) {
+        mean += value;
+    }
+    mean /= values.size();
+    // nothing grows, which only a constant fits
+    if (mean == 0) {
+        errors.fill(1);
+        errors[static_cast<size_t>(Complexity::constant)] = 0;
+        return errors;
+    }
+    auto f = [](size_t i, double n) {
+        switch (static_cast<Complexity>(i)) {
+            case Complexity::constant:
+                return 1.0;
+            case Complexity::logarithmic:
+                return std::log2(n);
+            case Complexity::linear:
+                return n;
+            case Complexity::linearithmic:
+                return n * std::log2(n);
+            case Complexity::quadratic:
+                return n * n;
+        }
+        return 0.0;
+    };
+    for (size_t i = 0; i < errors.size(); ++i) {
+        double tf = 0, ff = 0;
+        for (size_t j = 0; j < sizes.size(); ++j) {
+            tf += values[j] * f(i, sizes[j]);
+            ff += f(i, sizes[j]) * f(i, sizes[j]);
+        }
+        double coefficient = ff > 0 ? tf / ff : 0;
+        double squares = 0;
+        for (size_t j = 0; j < sizes.size(); ++j) {
+            auto residual = values[j] - coefficient * f(i, sizes[j]);
+            squares += residual * residual;
+        }
+        errors[i] = std::sqrt(squares / sizes.size()) / mean;
+    }
+    return errors;
+}
+
+// the most recently used patterns come first, so that patterns built at runtime can't grow the
+// cache without bound. the returned regex stays valid until the next call on this thread
+const std::regex& compiledRegex(std::string_view pattern) {
+    constexpr size_t capacity = 32;
+    thread_local std::list<std::pair<std::string, std::regex>> cache;
+    auto it = std::ranges::find(cache, pattern, [](auto& entry) -> std::string_view { return entry.first; });
+    if (it != cache.end()) {
+        cache.splice(cache.begin(), cache, it);
+        return cache.front().second;
+    }
+    cache.emplace_front(pattern, std::regex(pattern.begin(), pattern.end()));
+    if (cache.size() > capacity) {
+        cache.pop_back();
+    }
+    return cache.front().second;
+}
+
+bool isUuid(std::string_view text) {
+    if (text.size() != 36) {
+        return false;
+    }
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (text[i] != '-') {
+                return false;
+            }
+        } else if (!std::isxdigit(static_cast<unsigned char>(text[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string abbreviate(std::string_view text) {
+    if (text.size() <= maxInline) {
+        return to_str(text);
+    }
+    return std::format("\"{}...\" ({} characters)", text.substr(0, maxInline), text.size());
+}
+
+namespace {
+
+// elements shown around each difference
+const size_t diffContext = 3;
+// the diff gives up beyond this many removed and inserted elements
+const size_t maxEdits = 100;
+// the diff only looks at this many elements after the first difference
+const size_t maxWindow = 4096;
+
+struct Edit {
+        enum Kind { keep, remove, insert } kind;
+        size_t expected, actual;
+};
+
+// Myers' shortest edit script from expected to actual, none when it needs more than maxEdits
+std::optional<std::vector<Edit>> shortestEdit(size_t n, size_t m, const std::function<bool(size_t, size_t)>& equal) {
+    auto max = static_cast<long>(std::min(n + m, maxEdits));
+    // v[max + k] is the furthest x reached on diagonal k = x - y, a copy is kept per step to backtrack
+    std::vector<long> v(2 * max + 2, 0);
+    std::vector<std::vector<long>> trace;
+    for (long d = 0; d <= max; ++d) {
+        trace.push_back(v);
+        for (long k = -d; k <= d; k += 2) {
+            long x = (k == -d || (k != d && v[max + k - 1] < v[max + k + 1])) ? v[max + k + 1] : v[max + k - 1] + 1;
+            long y = x - k;
+            while (x < static_cast<long>(n) && y < static_cast<long>(m) && equal(x, y)) {
+                ++x;
+                ++y;
+            }
+            v[max + k] = x;
+            if (x < static_cast<long>(n) || y < static_cast<long>(m)) {
+                continue;
+            }
+            std::vector<Edit> edits;
+            for (long step = d; step >= 0; --step) {
+                auto& previous = trace[step];
+                long kk = x - y;
+                long previousK = step == 0 ? 0 : (kk == -step || (kk != step && previous[max + kk - 1] < previous[max + kk + 1])) ? kk + 1 : kk - 1;
+                long previousX = step == 0 ? 0 : previous[max + previousK];
+                long previousY = previousX - previousK;
+                while (x > previousX && y > previousY) {
+                    --x;
+                    --y;
+                    edits.push_back({Edit::keep, size_t(x), size_t(y)});
+                }
+                if (step > 0) {
+                    if (x == previousX) {
+                        edits.push_back({Edit::insert, size_t(x), size_t(previousY)});
+                    } else {
+                        edits.push_back({Edit::remove, size_t(previousX), size_t(y)});
+                    }
+                    x = previousX;
+                    y = previousY;
+                }
+            }
+            std::reverse(edits.begin(), edits.end());
+            return edits;
+        }
+    }
+    return {};
+}
+
+}  // namespace
+
+std::string formatDiff(size_t expectedSize, size_t actualSize, size_t first, const std::function<bool(size_t, size_t)>& equal,
+                       const std::function<std::string(bool actual, size_t index)>& element) {
+    auto clip = [](std::string text) {
+        if (text.size() > 2 * maxInline) {
+            text.resize(2 * maxInline);
+            text += "...";
+        }
+        return text;
+    };
+    size_t suffix = 0;
+    while (suffix < expectedSize - first && suffix < actualSize - first && equal(expectedSize - 1 - suffix, actualSize - 1 - suffix)) {
+        ++suffix;
+    }
+    auto n = expectedSize - first - suffix, m = actualSize - first - suffix;
+    bool truncated = n > maxWindow || m > maxWindow;
+    if (truncated) {
+        // the differences continue past the window, so it's end isn't aligned like the suffix
+        n = std::min(n, maxWindow);
+        m = std::min(m, maxWindow);
+        suffix = 0;
+    }
+    auto edits = shortestEdit(n, m, [&](size_t i, size_t j) { return equal(first + i, first + j); });
+    if (edits && truncated) {
+        // edits after the last kept element only make up for where the window was cut
+        auto last = std::find_if(edits->rbegin(), edits->rend(), [](auto& edit) { return edit.kind == Edit::keep; });
+        if (last != edits->rend()) {
+            edits->erase(last.base(), edits->end());
+        }
+    }
+
+    std::string out;
+    if (!edits) {
+        if (first > 0) {
+            out += "\n    " + clip(element(false, first - 1));
+        }
+        for (size_t i = first; i < expectedSize && i < first + diffContext; ++i) {
+            out += "\n  - " + clip(element(false, i));
+        }
+        for (size_t i = first; i < actualSize && i < first + diffContext; ++i) {
+            out += "\n  + " + clip(element(true, i));
+        }
+        out += std::format("\n  ... more than {} differences", maxEdits);
+        return out;
+    }
+
+    // the script from the context before the first difference to the context after the last one
+    std::vector<Edit> script;
+    size_t begin = first > diffContext ? first - diffContext : 0;
+    for (size_t i = begin; i < first; ++i) {
+        script.push_back({Edit::keep, i, i});
+    }
+    for (auto& edit : *edits) {
+        script.push_back({edit.kind, first + edit.expected, first + edit.actual});
+    }
+    for (size_t i = 0; i < suffix && i < diffContext; ++i) {
+        script.push_back({Edit::keep, expectedSize - suffix + i, actualSize - suffix + i});
+    }
+    std::vector<bool> visible(script.size());
+    for (size_t i = 0; i < script.size(); ++i) {
+        if (script[i].kind != Edit::keep) {
+            for (size_t j = i > diffContext ? i - diffContext : 0; j < script.size() && j <= i + diffContext; ++j) {
+                visible[j] = true;
+            }
+        }
+    }
+    bool gap = begin > 0;
+    for (size_t i = 0; i < script.size(); ++i) {
+        if (!visible[i]) {
+            gap = true;
+            continue;
+        }
+        if (gap) {
+            out += "\n  ...";
+            gap = false;
+        }
+        switch (script[i].kind) {
+            case Edit::keep:
+                out += "\n    " + clip(element(false, script[i].expected));
+                break;
+            case Edit::remove:
+                out += "\n  - " + clip(element(false, script[i].expected));
+                break;
+            case Edit::insert:
+                out += "\n  + " + clip(element(true, script[i].actual));
+                break;
+        }
+    }
+    if (gap || suffix > diffContext || truncated) {
+        out += "\n  ...";
+    }
+    return out;
+}
+
+std::string describeInequality(std::string_view actual, std::string_view expected) {
+    if (actual.size() <= maxInline && expected.size() <= maxInline) {
+        return std::format("expected {} to equal {}", to_str(actual), to_str(expected));
+    }
+    auto first = firstMismatch(actual.data(), expected.data(), std::min(actual.size(), expected.size()));
+    if (actual.find('\n') == std::string_view::npos && expected.find('\n') == std::string_view::npos) {
+        auto window = [&](std::string_view text) {
+            size_t begin = first > maxInline / 2 ? first - maxInline / 2 : 0;
+            return std::format("{}{}{}", begin > 0 ? "..." : "", to_str(text.substr(begin, maxInline)), begin + maxInline < text.size() ? "..." : "");
+        };
+        return std::format("expected {} to equal {}, first difference at index {} ({} and {} characters)", window(actual), window(expected), first,
+                           actual.size(), expected.size());
+    }
+    auto split = [](std::string_view text) {
+        std::vector<std::string_view> lines;
+        for (size_t begin = 0;;) {
+            auto end = text.find('\n', begin);
+            if (end == std::string_view::npos) {
+                lines.push_back(text.substr(begin));
+                return lines;
+            }
+            lines.push_back(text.substr(begin, end - begin));
+            begin = end + 1;
+        }
+    };
+    auto actualLines = split(actual), expectedLines = split(expected);
+    size_t firstLine = std::count(actual.begin(), actual.begin() + first, '\n');
+    return std::format("expected {} lines to equal {} lines, first difference in line {} (- expected, + actual):", actualLines.size(), expectedLines.size(),
+                       firstLine + 1) +
+           formatDiff(
+               expectedLines.size(), actualLines.size(), firstLine, [&](size_t i, size_t j) { return expectedLines[i] == actualLines[j]; },
+               [&](bool isActual, size_t index) { return std::string((isActual ? actualLines : expectedLines)[index].substr(0, 2 * maxInline + 1)); });
+}
+
+std::optional<size_t> findBytes(std::span<const std::byte> haystack, std::span<const std::byte> needle) {
+    if (needle.empty()) {
+        return 0;
+    }
+    if (needle.size() > haystack.size()) {
+        return {};
+    }
+    // memchr() skips to the candidates, both it and memcmp() are vectorized by the libc
+    auto data = reinterpret_cast<const unsigned char*>(haystack.data());
+    auto last = data + haystack.size() - needle.size();
+    for (auto p = data; p <= last; ++p) {
+        p = static_cast<const unsigned char*>(std::memchr(p, std::to_integer<int>(needle[0]), last - p + 1));
+        if (!p) {
+            break;
+        }
+        if (std::memcmp(p, needle.data(), needle.size()) == 0) {
+            return p - data;
+        }
+    }
+    return {};
+}
+
+std::string formatBytes(std::span<const std::byte> bytes) {
+    std::string out;
+    for (size_t i = 0; i < bytes.size() && i < 16; ++i) {
+        out += std::format("{}{:02x}", i == 0 ? "" : " ", std::to_integer<unsigned>(bytes[i]));
+    }
+    if (bytes.size() > 16) {
+        out += std::format(" ... ({} bytes)", bytes.size());
+    }
+    return out;
+}
+
+namespace {
+
+const size_t bytesPerLine = 16;
+
+// e.g. "00000010  00 01 02 03 04 05 06 07  08 09 0a 0b 0c 0d 0e 0f  |................|"
+std::string hexdumpLine(std::span<const std::byte> bytes, size_t offset) {
+    auto line = bytes.subspan(offset, std::min(bytesPerLine, bytes.size() - offset));
+    auto out = std::format("{:08x} ", offset);
+    std::string ascii;
+    for (size_t i = 0; i < bytesPerLine; ++i) {
+        if (i == bytesPerLine / 2) {
+            out += ' ';
+        }
+        if (i < line.size()) {
+            auto byte = std::to_integer<unsigned char>(line[i]);
+            out += std::format(" {:02x}", byte);
+            ascii += std::isprint(byte) ? static_cast<char>(byte) : '.';
+        } else {
+            out += "   ";
+        }
+    }
+    return out + "  |" + ascii + "|";
+}
+
+// "^^" below the marked bytes of a hexdumpLine()
+std::string hexdumpMarks(const std::array<bool, bytesPerLine>& marked) {
+    std::string out;
+    for (size_t i = 0; i < bytesPerLine; ++i) {
+        if (marked[i]) {
+            size_t column = 10 + 3 * i + (i >= bytesPerLine / 2 ? 1 : 0);
+            out.resize(column, ' ');
+            out += "^^";
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+std::string formatBytesDiff(std::span<const std::byte> expected, std::span<const std::byte> actual, size_t first) {
+    auto size = std::max(expected.size(), actual.size());
+    size_t begin = first / bytesPerLine > 0 ? first / bytesPerLine - 1 : 0;
+    size_t end = std::min(first / bytesPerLine + 3, (size + bytesPerLine - 1) / bytesPerLine);
+    std::string out;
+    if (begin > 0) {
+        out += "\n  ...";
+    }
+    for (size_t line = begin; line < end; ++line) {
+        size_t offset = line * bytesPerLine;
+        std::array<bool, bytesPerLine> marked = {};
+        bool differs = false;
+        for (size_t i = 0; i < bytesPerLine && offset + i < size; ++i) {
+            auto inExpected = offset + i < expected.size(), inActual = offset + i < actual.size();
+            marked[i] = inExpected != inActual || (inExpected && expected[offset + i] != actual[offset + i]);
+            differs |= marked[i];
+        }
+        if (!differs) {
+            out += "\n    " + hexdumpLine(actual, offset);
+            continue;
+        }
+        if (offset < expected.size()) {
+            out += "\n  - " + hexdumpLine(expected, offset);
+        }
+        if (offset < actual.size()) {
+            out += "\n  + " + hexdumpLine(actual, offset);
+        }
+        out += "\n    " + hexdumpMarks(marked);
+    }
+    if (end * bytesPerLine < size) {
+        out += "\n  ...";
+    }
+    return out;
+}
+
+std::string formatBytesAt(std::span<const std::byte> bytes, size_t offset, size_t length) {
+    size_t begin = offset / bytesPerLine > 0 ? offset / bytesPerLine - 1 : 0;
+    size_t last = (offset + std::max<size_t>(length, 1) - 1) / bytesPerLine;
+    size_t end = std::min({last + 2, offset / bytesPerLine + 4, (bytes.size() + bytesPerLine - 1) / bytesPerLine});
+    std::string out;
+    if (begin > 0) {
+        out += "\n  ...";
+    }
+    for (size_t line = begin; line < end; ++line) {
+        std::array<bool, bytesPerLine> marked = {};
+        bool any = false;
+        for (size_t i = 0; i < bytesPerLine; ++i) {
+            auto at = line * bytesPerLine + i;
+            marked[i] = offset <= at && at < offset + length;
+            any |= marked[i];
+        }
+        out += "\n    " + hexdumpLine(bytes, line * bytesPerLine);
+        if (any) {
+            out += "\n    " + hexdumpMarks(marked);
+        }
+    }
+    if (end * bytesPerLine < bytes.size()) {
+        out += "\n  ...";
+    }
+    return out;
+}
+
+namespace {
+
+template <typename F>
+using bits_t = std::conditional_t<sizeof(F) == 4, uint32_t, uint64_t>;
+
+// maps the sign and magnitude of the floating point bits to unsigned integers in the same order
+template <typename F>
+bits_t<F> biased(F value) {
+    auto bits = std::bit_cast<bits_t<F>>(value);
+    const bits_t<F> sign = bits_t<F>(1) << (sizeof(F) * 8 - 1);
+    return (bits & sign) ? ~bits + 1 : bits | sign;
+}
+
+template <typename F>
+bits_t<F> ulps(F a, F b) {
+    auto x = biased(a), y = biased(b);
+    return x >= y ? x - y : y - x;
+}
+
+// small enough to stay in the cache for the second pass over a block with mismatches
+const size_t closenessBlock = 1024;
+
+// the first pass over each block only counts the mismatches and is branch free, so that it vectorizes.
+// the rare blocks with mismatches are passed again to find the worst one
+template <typename F, typename Error, typename Tolerance>
+Closeness closeness(std::span<const F> actual, std::span<const F> expected, Error error, Tolerance tolerance) {
+    Closeness result;
+    double worst = -1;
+    for (size_t begin = 0; begin < actual.size(); begin += closenessBlock) {
+        size_t end = std::min(begin + closenessBlock, actual.size());
+        size_t mismatches = 0;
+        for (size_t i = begin; i < end; ++i) {
+            F a = actual[i], e = expected[i];
+            mismatches += !((a == e) | (error(a, e) <= tolerance(a, e)));
+        }
+        if (mismatches == 0) {
+            continue;
+        }
+        result.mismatches += mismatches;
+        for (size_t i = begin; i < end; ++i) {
+            F a = actual[i], e = expected[i];
+            double value = error(a, e), limit = tolerance(a, e);
+            if ((a == e) | (value <= limit)) {
+                continue;
+            }
+            // NaN is worse than any difference
+            double outside = std::isnan(value) ? std::numeric_limits<double>::infinity() : limit > 0 ? value / limit : value;
+            if (outside > worst) {
+                worst = outside;
+                result.worst = i;
+            }
+            if (std::isnan(value) || value > result.maxError) {
+                result.maxError = value;
+            }
+        }
+    }
+    return result;
+}
+
+template <typename F>
+Closeness compareClose(std::span<const F> actual, std::span<const F> expected, F abs, F rel) {
+    return closeness(
+        actual, expected, [](F a, F e) { return std::abs(a - e); }, [=](F a, F e) { return std::max(abs, rel * std::max(std::abs(a), std::abs(e))); });
+}
+
+template <typename F>
+Closeness compareUlps(std::span<const F> actual, std::span<const F> expected, uint64_t limit) {
+    // NaN is never close, it's distance is made larger than any limit
+    return closeness(
+        actual, expected, [](F a, F e) { return (a != a) | (e != e) ? std::numeric_limits<double>::quiet_NaN() : double(ulps(a, e)); },
+        [=](F, F) { return double(limit); });
+}
+
+}  // namespace
+
+uint64_t ulpDistance(float a, float b) { return ulps(a, b); }
+uint64_t ulpDistance(double a, double b) { return ulps(a, b); }
+
+Closeness compareClose(std::span<const float> actual, std::span<const float> expected, double abs, double rel) {
+    return compareClose<float>(actual, expected, abs, rel);
+}
+Closeness compareClose(std::span<const double> actual, std::span<const double> expected, double abs, double rel) {
+    return compareClose<double>(actual, expected, abs, rel);
+}
+Closeness compareUlps(std::span<const float> actual, std::span<const float> expected, uint64_t ulps) { return compareUlps<float>(actual, expected, ulps); }
+Closeness compareUlps(std::span<const double> actual, std::span<const double> expected, uint64_t ulps) {
+    return compareUlps<double>(actual, expected, ulps);
+}
+
+// a regression fails only when the U test finds the samples significantly above the
+// baseline's and they are shifted up by more than the threshold. the shift is the
+// estimate that goes with the U test, so that both agree on the direction
+void Example::compareWithBaseline() {
+    std::vector<double> samples(benchmark.values.begin(), benchmark.values.begin() + benchmark.samples);
+    auto p = mannWhitneyU(samples, baseline);
+    auto shift = shiftEstimate(samples, baseline);
+    if (p >= m_significance || shift <= 0) {
+        return;
+    }
+    std::vector<double> sorted(baseline);
+    std::sort(sorted.begin(), sorted.end());
+    auto median = (sorted[(sorted.size() - 1) / 2] + sorted[sorted.size() / 2]) / 2;
+    if (median > 0 && shift / median <= m_threshold) {
+        return;
+    }
+    passed = false;
+    auto slower = median > 0 ? std::format("{:.1f}%", shift / median * 100) : formatNanoseconds(shift);
+    error = assertion_error(std::format("{} slower (p={:.2g})", slower, p), "unknown", 0);
+}
+
+void Example::record(Statistics* statistics) const {
+    statistics->totalDuration += duration;
+    if (skipped) {
+        ++statistics->numSkippedTests;
+    } else {
+        if (passed) {
+            ++statistics->numPassedTests;
+        } else {
+            ++statistics->numFailedTests;
+        }
+    }
+}
+
+void Example::schedule(ThreadPool* pool, Sequencer* sequencer, std::function<void()> done) {
+    pool->submit([this, pool, sequencer, done] {
+        evaluate(&pool->statistics(), sequencer);
+        done();
+    });
+}
+
+void StatusDatabase::update(ExampleGroup* root) {
+    updateStatus(root, &failed, &paths);
+    if (!root->m_paths.empty()) {
+        return;  // the tree is incomplete, the ids of failures outside of the paths are unknown
+    }
+    std::unordered_set<uint64_t> ids;
+    collectIds(root, &ids);
+    std::erase_if(failed, [&](uint64_t id) { return !ids.contains(id); });
+    std::erase_if(paths, [&](auto& entry) { return !failed.contains(entry.first); });
+}
+
+std::string Item::path() const {
+    if (!parent) {
+        return name;
+    }
+    auto prefix = parent->path();
+    return prefix.empty() ? name : std::format("{} > {}", prefix, name);
+}
+
+void ConsoleReporter::beginRun() { std::println("TEST REPORT\n"); }
+
+void ConsoleReporter::beginGroup(const ExampleGroup* group) {
+    std::println("{}{}{}{}", indent, colour::boldWhite, group->name, colour::reset);
+    indent += "  ";
+}
+
+void ConsoleReporter::endExample(const Example* example) {
+    auto status = STATUS_FAILED;
+    if (example->skipped) {
+        status = STATUS_SKIPPED;
+    } else {
+        if (example->passed) {
+            status = STATUS_PASSED;
+        }
+    }
+    if (example->benchmark.samples > 0) {
+        std::println("{}{}{}", indent, formatStatus(status, example->name), formatBenchmark(example->benchmark));
+    } else {
+        std::println("{}{}{}", indent, formatStatus(status, example->name), formatDuration(example->duration, example->history));
+    }
+    if (!example->passed) {
+        failures.push_back(std::format("  {}∙ {}{}\n    {}:{}: {}", colour::red, example->path(), colour::reset, example->error.filename, example->error.line,
+                                       example->error.what()));
+    }
+}
+
+void ConsoleReporter::hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) {
+    std::println("{}{}", indent, formatStatus(STATUS_FAILED, std::format("{}() failed", hook)));
+    failures.push_back(std::format("  {}∙ {} > {}(){}\n    {}:{}: {}", colour::red, group->path(), hook, colour::reset, error.filename, error.line, error.what()));
+}
+
+void ConsoleReporter::endGroup(const ExampleGroup*) { indent.resize(indent.size() - 2); }
+
+void ConsoleReporter::endRun(const Statistics& statistics) {
+    if (statistics.numTotalTests > 0) {
+        std::println("");
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(statistics.totalDuration);
+    std::println("{}Finished {} tests in {} test suites in {}", colour::green, statistics.numTotalTests, statistics.numTotalTestSuites, ms);
+    std::println("");
+
+    if (statistics.numTotalTests > 0) {
+        std::println("{}{}SUMMARY:{}\n", colour::boldWhite, colour::underline, colour::reset);
+    }
+    if (statistics.numPassedTests != 0) {
+        std::println("{}", formatStatus(STATUS_PASSED, std::format("{} tests completed", statistics.numPassedTests)));
+    }
+    if (statistics.numSkippedTests != 0) {
+        std::println("{}", formatStatus(STATUS_SKIPPED, std::format("{} tests skipped", statistics.numSkippedTests)));
+    }
+    if (statistics.numFailedTests != 0) {
+        std::println("{}", formatStatus(STATUS_FAILED, std::format("{} tests failed", statistics.numFailedTests)));
+    }
+    if (statistics.numTotalTests > 0) {
+        std::println("");
+    }
+
+    if (!failures.empty()) {
+        std::println("{}{}FAILED TESTS:{}\n", colour::boldWhite, colour::underline, colour::reset);
+        for (auto& failure : failures) {
+            std::println("{}", failure);
+        }
+        std::println("");
+    }
+    std::println("{}", colour::reset);
+}
+
+//
+// machine readable reporters
+//
+
+BufferedWriter::~BufferedWriter() {
+    flush();
+    if (owned) {
+        close(fd);
+    }
+}
+
+std::unique_ptr<BufferedWriter> BufferedWriter::open(std::string_view destination) {
+    if (destination.empty() || destination == "-") {
+        return std::make_unique<BufferedWriter>(STDOUT_FILENO);
+    }
+    if (destination.starts_with('&')) {
+        int fd = -1;
+        auto [end, ec] = std::from_chars(destination.data() + 1, destination.data() + destination.size(), fd);
+        if (ec != std::errc() || end != destination.data() + destination.size() || fcntl(fd, F_GETFD) < 0) {
+            return nullptr;
+        }
+        return std::make_unique<BufferedWriter>(fd);
+    }
+    int fd = ::open(std::string(destination).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::make_unique<BufferedWriter>(fd, true);
+}
+
+BufferedWriter& BufferedWriter::operator<<(std::string_view data) {
+    if (buffer.size() + data.size() > capacity) {
+        flush();
+    }
+    if (data.size() >= capacity) {
+        writeAll(fd, data.data(), data.size());
+    } else {
+        buffer.append(data);
+    }
+    return *this;
+}
+
+void BufferedWriter::flush() {
+    if (buffer.empty()) {
+        return;
+    }
+    if (fd == STDOUT_FILENO) {
+        fflush(stdout);  // keep the order with std::print()
+    }
+    writeAll(fd, buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+void Reporters::beginRun() {
+    for (auto& reporter : reporters) {
+        reporter->beginRun();
+    }
+}
+void Reporters::beginGroup(const ExampleGroup* group) {
+    for (auto& reporter : reporters) {
+        reporter->beginGroup(group);
+    }
+}
+void Reporters::beginExample(const Example* example) {
+    for (auto& reporter : reporters) {
+        reporter->beginExample(example);
+    }
+}
+void Reporters::endExample(const Example* example) {
+    for (auto& reporter : reporters) {
+        reporter->endExample(example);
+    }
+}
+void Reporters::hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) {
+    for (auto& reporter : reporters) {
+        reporter->hookFailed(group, hook, error);
+    }
+}
+void Reporters::endGroup(const ExampleGroup* group) {
+    for (auto& reporter : reporters) {
+        reporter->endGroup(group);
+    }
+}
+void Reporters::endRun(const Statistics& statistics) {
+    for (auto& reporter : reporters) {
+        reporter->endRun(statistics);
+    }
+}
+
+std::string escapeXml(std::string_view text) {
+    std::string result;
+    result.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '<': result += "&lt;"; break;
+            case '>': result += "&gt;"; break;
+            case '&': result += "&amp;"; break;
+            case '"': result += "&quot;"; break;
+            case '\'': result += "&apos;"; break;
+            default:
+                // control characters other than tab, newline and carriage return are not allowed in XML 1.0
+                if (static_cast<unsigned char>(c) < 0x20 && c != '\t' && c != '\n' && c != '\r') {
+                    result += '?';
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result;
+}
+
+std::string escapeXmlAttribute(std::string_view text) {
+    std::string result;
+    result.reserve(text.size());
+    for (char c : escapeXml(text)) {
+        switch (c) {
+            case '\t': result += "&#9;"; break;
+            case '\n': result += "&#10;"; break;
+            case '\r': result += "&#13;"; break;
+            default: result += c;
+        }
+    }
+    return result;
+}
+
+std::string escapeJson(std::string_view text) {
+    std::string result;
+    result.reserve(text.size() + 2);
+    result += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    result += std::format("\\u{:04x}", c);
+                } else {
+                    result += c;
+                }
+        }
+    }
+    result += '"';
+    return result;
+}
+
+namespace {
+
+double seconds(std::chrono::nanoseconds duration) { return std::chrono::duration<double>(duration).count(); }
+double milliseconds(std::chrono::nanoseconds duration) { return std::chrono::duration<double, std::milli>(duration).count(); }
+
+std::string location(const assertion_error& error) { return std::format("{}:{}", error.filename, error.line); }
+
+// the root's name is empty
+std::string groupPath(const ExampleGroup* group) { return group->parent ? group->path() : ""; }
+
+}  // namespace
+
+void JUnitReporter::beginRun() { *out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n"; }
+
+void JUnitReporter::beginGroup(const ExampleGroup*) { suites.emplace_back(); }
+
+void JUnitReporter::endExample(const Example* example) {
+    auto& suite = suites.back();
+    ++suite.tests;
+    suite.duration += example->duration;
+    suite.testcases += std::format("    <testcase classname=\"{}\" name=\"{}\" time=\"{:.6f}\"", escapeXml(groupPath(example->parent)), escapeXml(example->name),
+                                   seconds(example->duration));
+    if (example->skipped) {
+        ++suite.skipped;
+        suite.testcases += ">\n      <skipped/>\n    </testcase>\n";
+    } else if (!example->passed) {
+        ++suite.failures;
+        suite.testcases += std::format(">\n      <failure message=\"{}\" type=\"assertion\">{}: {}</failure>\n    </testcase>\n", escapeXmlAttribute(example->error.what()),
+                                       escapeXml(location(example->error)), escapeXml(example->error.what()));
+    } else {
+        suite.testcases += "/>\n";
+    }
+}
+
+void JUnitReporter::hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) {
+    auto& suite = suites.back();
+    ++suite.tests;
+    ++suite.failures;
+    suite.testcases += std::format(
+        "    <testcase classname=\"{}\" name=\"{}()\" time=\"0\">\n      <failure message=\"{}\" type=\"hook\">{}: {}</failure>\n    </testcase>\n",
+        escapeXml(groupPath(group)), hook, escapeXmlAttribute(error.what()), escapeXml(location(error)), escapeXml(error.what()));
+}
+
+void JUnitReporter::endGroup(const ExampleGroup* group) {
+    auto& suite = suites.back();
+    if (suite.tests > 0) {
+        *out << std::format("  <testsuite name=\"{}\" tests=\"{}\" failures=\"{}\" errors=\"0\" skipped=\"{}\" time=\"{:.6f}\">\n", escapeXml(groupPath(group)),
+                            suite.tests, suite.failures, suite.skipped, seconds(suite.duration))
+             << suite.testcases << "  </testsuite>\n";
+    }
+    suites.pop_back();
+}
+
+void JUnitReporter::endRun(const Statistics&) {
+    *out << "</testsuites>\n";
+    out->flush();
+}
+
+void JsonLinesReporter::beginGroup(const ExampleGroup* group) { *out << std::format("{{\"event\":\"beginGroup\",\"path\":{}}}\n", escapeJson(groupPath(group))); }
+
+void JsonLinesReporter::endExample(const Example* example) {
+    auto status = example->skipped ? "skipped" : example->passed ? "passed" : "failed";
+    *out << std::format("{{\"event\":\"example\",\"path\":{},\"status\":\"{}\",\"duration\":{:.3f}", escapeJson(example->path()), status,
+                        milliseconds(example->duration));
+    if (example->benchmark.samples > 0) {
+        auto& benchmark = example->benchmark;
+        *out << std::format(",\"benchmark\":{{\"mean\":{:.3f},\"median\":{:.3f},\"stddev\":{:.3f},\"min\":{:.3f},\"samples\":{},\"iterations\":{}}}",
+                            benchmark.mean, benchmark.median, benchmark.stddev, benchmark.min, benchmark.samples, benchmark.iterations);
+    }
+    if (!example->skipped) {
+        auto& resources = example->resources;
+        *out << std::format(
+            ",\"resources\":{{\"user\":{:.3f},\"system\":{:.3f},\"maxRss\":{},\"minorFaults\":{},\"majorFaults\":{},\"voluntarySwitches\":{},"
+            "\"involuntarySwitches\":{}}}",
+            milliseconds(resources.user), milliseconds(resources.system), resources.maxRss, resources.minorFaults, resources.majorFaults,
+            resources.voluntarySwitches, resources.involuntarySwitches);
+    }
+    if (!example->skipped && example->counters.software) {
+        auto& counters = example->counters;
+        *out << std::format(",\"counters\":{{\"taskClock\":{:.3f},\"pageFaults\":{},\"contextSwitches\":{}", milliseconds(counters.taskClock),
+                            counters.pageFaults, counters.contextSwitches);
+        if (counters.hardware) {
+            *out << std::format(",\"instructions\":{},\"cycles\":{},\"cacheMisses\":{},\"branchMisses\":{}", counters.instructions, counters.cycles,
+                                counters.cacheMisses, counters.branchMisses);
+        }
+        *out << "}";
+    }
+    if (!example->passed) {
+        *out << std::format(",\"filename\":{},\"line\":{},\"message\":{}", escapeJson(example->error.filename), example->error.line,
+                            escapeJson(example->error.what()));
+    }
+    *out << "}\n";
+}
+
+void JsonLinesReporter::hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) {
+    *out << std::format("{{\"event\":\"hookFailed\",\"path\":{},\"hook\":\"{}\",\"filename\":{},\"line\":{},\"message\":{}}}\n", escapeJson(groupPath(group)),
+                        hook, escapeJson(error.filename), error.line, escapeJson(error.what()));
+}
+
+void JsonLinesReporter::endGroup(const ExampleGroup* group) { *out << std::format("{{\"event\":\"endGroup\",\"path\":{}}}\n", escapeJson(groupPath(group))); }
+
+void JsonLinesReporter::endRun(const Statistics& statistics) {
+    *out << std::format("{{\"event\":\"summary\",\"tests\":{},\"passed\":{},\"failed\":{},\"skipped\":{},\"suites\":{},\"duration\":{:.3f}}}\n",
+                        statistics.numTotalTests, statistics.numPassedTests, statistics.numFailedTests, statistics.numSkippedTests,
+                        statistics.numTotalTestSuites, milliseconds(statistics.totalDuration));
+    out->flush();
+}
+
+namespace {
+
+// the YAML block following a failure
+std::string tapDiagnostics(const assertion_error& error, std::chrono::nanoseconds duration) {
+    return std::format("  ---\n  message: {}\n  at: {}\n  duration_ms: {:.3f}\n  ...\n", escapeJson(error.what()), escapeJson(location(error)),
+                       milliseconds(duration));
+}
+
+// '#' starts a directive in TAP
+std::string tapDescription(std::string text) {
+    std::ranges::replace(text, '#', '_');
+    std::ranges::replace(text, '\n', ' ');
+    return text;
+}
+
+}  // namespace
+
+void TapReporter::beginRun() { *out << "TAP version 13\n"; }
+
+void TapReporter::endExample(const Example* example) {
+    ++count;
+    auto description = tapDescription(example->path());
+    if (example->skipped) {
+        *out << std::format("ok {} - {} # SKIP\n", count, description);
+    } else if (example->passed) {
+        *out << std::format("ok {} - {} # time={:.3f}ms\n", count, description, milliseconds(example->duration));
+    } else {
+        *out << std::format("not ok {} - {} # time={:.3f}ms\n", count, description, milliseconds(example->duration))
+             << tapDiagnostics(example->error, example->duration);
+    }
+}
+
+void TapReporter::hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) {
+    ++count;
+    auto path = groupPath(group);
+    *out << std::format("not ok {} - {}{}()\n", count, tapDescription(path.empty() ? path : path + " > "), hook) << tapDiagnostics(error, {});
+}
+
+void TapReporter::endRun(const Statistics&) {
+    *out << std::format("1..{}\n", count);
+    out->flush();
+}
+
+void TopReporter::endExample(const Example* example) {
+    if (example->skipped) {
+        return;
+    }
+    auto& resources = example->resources;
+    double value = 0;
+    if (metric == "duration") {
+        value = example->duration.count();
+    } else if (metric == "cpu") {
+        value = (resources.user + resources.system).count();
+    } else if (metric == "rss") {
+        value = resources.maxRss;
+    } else if (metric == "faults") {
+        value = resources.minorFaults + resources.majorFaults;
+    } else if (metric == "switches") {
+        value = resources.voluntarySwitches + resources.involuntarySwitches;
+    } else if (metric == "instructions") {
+        value = example->counters.instructions;
+    } else if (metric == "cycles") {
+        value = example->counters.cycles;
+    } else if (metric == "cache-misses") {
+        value = example->counters.cacheMisses;
+    } else if (metric == "branch-misses") {
+        value = example->counters.branchMisses;
+    }
+    if (value > 0) {
+        examples.emplace_back(value, example->path());
+    }
+}
+
+void TopReporter::endRun(const Statistics&) {
+    fflush(stdout);  // after the console's summary
+    auto n = std::min<size_t>(count, examples.size());
+    std::partial_sort(examples.begin(), examples.begin() + n, examples.end(), [](auto& a, auto& b) { return a.first > b.first; });
+    auto format = [this](double value) -> std::string {
+        if (metric == "duration" || metric == "cpu") {
+            return formatNanoseconds(value);
+        }
+        if (metric == "rss") {
+            return value >= 1 << 20 ? std::format("{:.1f}MiB", value / (1 << 20)) : std::format("{:.1f}KiB", value / (1 << 10));
+        }
+        return std::format("{}", value);
+    };
+    *out << std::format("{}{}TOP {} BY {}:{}\n\n", colour::boldWhite, colour::underline, n, metric, colour::reset);
+    std::vector<std::string> values;
+    size_t width = 0;
+    for (size_t i = 0; i < n; ++i) {
+        values.push_back(format(examples[i].first));
+        width = std::max(width, values.back().size());
+    }
+    for (size_t i = 0; i < n; ++i) {
+        *out << std::format("  {:>{}}  {}\n", values[i], width, examples[i].second);
+    }
+    *out << "\n";
+    out->flush();
+}
+
+std::unique_ptr<Reporter> createReporter(std::string_view spec) {
+    auto colon = spec.find(':');
+    auto name = spec.substr(0, colon);
+    auto destination = colon == std::string_view::npos ? std::string_view("-") : spec.substr(colon + 1);
+    if (name == "console") {
+        if (destination != "-") {
+            std::println(stderr, "kaffeeklatsch: the console reporter writes to stdout only");
+            return nullptr;
+        }
+        return std::make_unique<ConsoleReporter>();
+    }
+    if (name != "junit" && name != "jsonl" && name != "tap") {
+        std::println(stderr, "kaffeeklatsch: unknown reporter '{}', expected console, junit, jsonl or tap", name);
+        return nullptr;
+    }
+    auto out = BufferedWriter::open(destination);
+    if (!out) {
+        std::println(stderr, "kaffeeklatsch: failed to open '{}' for the {} reporter: {}", destination, name, strerror(errno));
+        return nullptr;
+    }
+    if (name == "junit") {
+        return std::make_unique<JUnitReporter>(std::move(out));
+    }
+    if (name == "jsonl") {
+        return std::make_unique<JsonLinesReporter>(std::move(out));
+    }
+    return std::make_unique<TapReporter>(std::move(out));
+}
+
+std::string_view topDestination(const std::vector<std::string>& reporters) {
+    return std::ranges::any_of(reporters, [](auto& spec) { return spec == "console" || spec == "console:-"; }) ? "-" : "&2";
+}
+
+// this one is for testing purposes
+void tmp_spec(std::function<void()> body, std::function<void(const Statistics&)> verify) { tmp_spec(Options(), body, verify); }
+
+void tmp_spec(const Options& options, std::function<void()> body, std::function<void(const Statistics&)> verify) {
+    tmp_spec(options, body, [&](const Statistics& statistics, ExampleGroup*) { verify(statistics); });
+}
+
+void tmp_spec(const Options& options, std::function<void()> body, std::function<void(const Statistics&, ExampleGroup* root)> verify) {
+    auto previousSuite = currentSuite;
+    // std::println(">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>");
+    detail::ExampleGroup root(nullptr, "", [] {});
+    for (auto& path : options.paths) {
+        root.m_paths.push_back(splitPath(path));
+    }
+    detail::currentSuite = &root;
+    body();
+    Statistics statistics;
+    evaluate(&root, &statistics, options);
+    currentSuite = previousSuite;
+
+    verify(statistics, &root);
+    // std::println("<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<");
+}
+
+bool parseOptions(int argc, char* argv[], Options* options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg(argv[i]);
+        if (arg == "--isolate") {
+            options->isolate = true;
+            continue;
+        }
+        if (arg.starts_with("--shard=")) {
+            auto value = arg.substr(8);
+            auto slash = value.find('/');
+            unsigned shard = 0, shards = 0;
+            if (slash == std::string_view::npos ||
+                std::from_chars(value.data(), value.data() + slash, shard).ptr != value.data() + slash ||
+                std::from_chars(value.data() + slash + 1, value.data() + value.size(), shards).ptr != value.data() + value.size() ||
+                shard < 1 || shard > shards) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}', expected --shard=<i>/<n> with 1 <= i <= n", arg);
+                return false;
+            }
+            options->shard = shard;
+            options->shards = shards;
+            continue;
+        }
+        if (arg == "--only-failures" || arg == "--next-failure") {
+            // the ids are read from the status file once the options are known
+            options->only.emplace();
+            options->onlyFirst = arg == "--next-failure";
+            continue;
+        }
+        if (arg.starts_with("--status=")) {
+            options->status = arg.substr(9);
+            continue;
+        }
+        if (arg.starts_with("--path=")) {
+            options->paths.emplace_back(arg.substr(7));
+            continue;
+        }
+        if (arg.starts_with("--grep=")) {
+            options->grep = arg.substr(7);
+            try {
+                std::regex re(options->grep);
+            } catch (std::regex_error& error) {
+                std::println(stderr, "kaffeeklatsch: invalid regular expression in '{}': {}", arg, error.what());
+                return false;
+            }
+            continue;
+        }
+        if (arg.starts_with("--timeout=")) {
+            auto value = arg.substr(10);
+            unsigned ms = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), ms);
+            if (ec != std::errc() || end != value.data() + value.size()) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}'", arg);
+                return false;
+            }
+            options->timeout = std::chrono::milliseconds(ms);
+            continue;
+        }
+        if (arg.starts_with("--grace=")) {
+            auto value = arg.substr(8);
+            unsigned ms = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), ms);
+            if (ec != std::errc() || end != value.data() + value.size()) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}'", arg);
+                return false;
+            }
+            options->grace = std::chrono::milliseconds(ms);
+            continue;
+        }
+        if (arg.starts_with("--reporter=")) {
+            auto spec = arg.substr(11);
+            auto name = spec.substr(0, spec.find(':'));
+            if (name != "console" && name != "junit" && name != "jsonl" && name != "tap") {
+                std::println(stderr, "kaffeeklatsch: unknown reporter in '{}', expected console, junit, jsonl or tap", arg);
+                return false;
+            }
+            options->reporters.emplace_back(spec);
+            continue;
+        }
+        if (arg.starts_with("--trace=")) {
+            options->trace = arg.substr(8);
+            continue;
+        }
+        if (arg.starts_with("--snapshots=")) {
+            options->snapshots = arg.substr(12);
+            continue;
+        }
+        if (arg == "--update-snapshots") {
+            options->updateSnapshots = true;
+            continue;
+        }
+        if (arg.starts_with("--cases=")) {
+            auto value = arg.substr(8);
+            unsigned cases = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), cases);
+            if (ec != std::errc() || end != value.data() + value.size() || cases == 0) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}', expected --cases=<n> with n >= 1", arg);
+                return false;
+            }
+            options->cases = cases;
+            continue;
+        }
+        if (arg.starts_with("--seed=")) {
+            auto value = arg.substr(7);
+            uint64_t seed = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), seed);
+            if (ec != std::errc() || end != value.data() + value.size()) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}'", arg);
+                return false;
+            }
+            options->seed = seed;
+            continue;
+        }
+        if (arg == "--counters") {
+            options->counters = true;
+            continue;
+        }
+        if (arg.starts_with("--top=")) {
+            auto value = arg.substr(6);
+            auto colon = value.find(':');
+            auto metric = value.substr(0, colon);
+            unsigned count = 10;
+            if (std::ranges::find(TopReporter::metrics, metric) == std::end(TopReporter::metrics) ||
+                (colon != std::string_view::npos &&
+                 (std::from_chars(value.data() + colon + 1, value.data() + value.size(), count).ptr != value.data() + value.size() || count == 0))) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}', expected --top=<metric>[:<n>] with metric duration, cpu, rss, faults, "
+                             "switches, instructions, cycles, cache-misses or branch-misses",
+                             arg);
+                return false;
+            }
+            options->top = metric;
+            options->topCount = count;
+            continue;
+        }
+        if (arg.starts_with("--baseline=")) {
+            options->baseline = arg.substr(11);
+            continue;
+        }
+        if (arg == "--save-baseline") {
+            options->saveBaseline = true;
+            continue;
+        }
+        if (arg.starts_with("--significance=")) {
+            std::string value(arg.substr(15));
+            char* end = nullptr;
+            double p = std::strtod(value.c_str(), &end);
+            if (value.empty() || end != value.c_str() + value.size() || !(p > 0 && p < 1)) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}', expected --significance=<p> with 0 < p < 1", arg);
+                return false;
+            }
+            options->significance = p;
+            continue;
+        }
+        if (arg.starts_with("--regression-threshold=")) {
+            auto value = arg.substr(23);
+            if (value.ends_with('%')) {
+                value.remove_suffix(1);
+            }
+            double percent = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), percent);
+            if (value.empty() || ec != std::errc() || end != value.data() + value.size() || percent < 0) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}', expected --regression-threshold=<percent>% with percent >= 0", arg);
+                return false;
+            }
+            options->regressionThreshold = percent / 100;
+            continue;
+        }
+        if (arg.starts_with("--timings=")) {
+            options->timings = arg.substr(10);
+            continue;
+        }
+        if (arg.starts_with("--jobs=")) {
+            auto value = arg.substr(7);
+            unsigned jobs = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), jobs);
+            if (ec != std::errc() || end != value.data() + value.size()) {
+                std::println(stderr, "kaffeeklatsch: invalid value in '{}'", arg);
+                return false;
+            }
+            // --jobs=0 uses all cores
+            options->jobs = jobs != 0 ? jobs : std::max(1u, std::thread::hardware_concurrency());
+            continue;
+        }
+        std::println(stderr, "kaffeeklatsch: unknown option '{}'", arg);
+        return false;
+    }
+    if (options->saveBaseline && options->baseline.empty()) {
+        std::println(stderr, "kaffeeklatsch: --save-baseline needs --baseline=<file>");
+        return false;
+    }
+    if (options->only && options->status.empty()) {
+        std::println(stderr, "kaffeeklatsch: {} needs --status=<file>", options->onlyFirst ? "--next-failure" : "--only-failures");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace detail
+
+int run(int argc, char* argv[]) {
+    detail::Options options;
+    if (!detail::parseOptions(argc, argv, &options)) {
+        return 1;
+    }
+    if (!isatty(STDOUT_FILENO)) {
+        colour::disable();
+    }
+    // the grace ends the process, thus it's taken from the options of the run only and not of tmp_spec()
+    detail::Watchdog::grace = options.grace.count();
+    detail::Reporters reporters;
+    if (options.reporters.empty()) {
+        options.reporters.push_back("console");
+    }
+    for (auto& spec : options.reporters) {
+        auto reporter = detail::createReporter(spec);
+        if (!reporter) {
+            return 1;
+        }
+        reporters.add(std::move(reporter));
+    }
+    if (!options.top.empty()) {
+        reporters.add(std::make_unique<detail::TopReporter>(options.top, options.topCount, detail::BufferedWriter::open(detail::topDestination(options.reporters))));
+    }
+    // keep stdout clean for machine readable output
+    if (std::ranges::any_of(options.reporters, [](auto& spec) { return spec.starts_with("console"); })) {
+        std::println("{}TEST RUN:\n\n{}START:{}\n", colour::boldWhite, colour::underline, colour::reset);
+    }
+    detail::ExampleGroup root(nullptr, "", [] {});
+    for (auto& path : options.paths) {
+        root.m_paths.push_back(detail::splitPath(path));
+    }
+    detail::currentSuite = &root;
+    for (auto& suite : detail::specs()) {
+        suite();
+    }
+    detail::TimingDatabase timings;
+    if (!options.timings.empty()) {
+        timings.load(options.timings);
+    }
+    detail::StatusDatabase status;
+    if (!options.status.empty()) {
+        status.load(options.status);
+    }
+    if (options.only) {
+        options.only = status.failures();
+    }
+    detail::BaselineDatabase baselines;
+    if (!options.baseline.empty()) {
+        bool loaded = baselines.load(options.baseline);
+        if (!loaded && !options.saveBaseline) {
+            std::println(stderr, "kaffeeklatsch: failed to read '{}', use --save-baseline to create it", options.baseline);
+            return 1;
+        }
+        if (!options.saveBaseline) {
+            options.baselines = &baselines;
+        }
+    }
+    // missing before the first snapshot is recorded
+    detail::SnapshotStore snapshots;
+    if (!options.snapshots.empty()) {
+        snapshots.load(options.snapshots);
+        snapshots.update = options.updateSnapshots;
+        options.snapshotStore = &snapshots;
+    }
+    detail::Statistics statistics;
+    options.reporter = &reporters;
+    detail::evaluate(&root, &statistics, options, &timings);
+    // the shards of a run need to balance with the same timings
+    if (!options.timings.empty() && options.shards == 1) {
+        detail::recordTimings(&root, &timings);
+        if (!timings.save(options.timings)) {
+            std::println(stderr, "kaffeeklatsch: failed to write '{}'", options.timings);
+        }
+    }
+    if (!options.status.empty()) {
+        status.update(&root);
+        if (!status.save(options.status)) {
+            std::println(stderr, "kaffeeklatsch: failed to write '{}'", options.status);
+        }
+    }
+    if (options.saveBaseline && !options.baseline.empty()) {
+        baselines.update(&root);
+        if (!baselines.save(options.baseline)) {
+            std::println(stderr, "kaffeeklatsch: failed to write '{}'", options.baseline);
+        }
+    }
+    if (options.snapshotStore) {
+        snapshots.prune(&root);
+        if (snapshots.changed() && !snapshots.save(options.snapshots)) {
+            std::println(stderr, "kaffeeklatsch: failed to write '{}'", options.snapshots);
+        }
+    }
+    detail::currentSuite = nullptr;
+    return 0;
+}
+
+detail::ExampleGroup& describe(const std::string& groupname, std::function<void()> body) {
+    auto parentSuite = detail::currentSuite;
+    auto group = std::make_unique<detail::ExampleGroup>(parentSuite, groupname, body);
+    detail::ExampleGroup* ptr = group.get();
+    parentSuite->items.push_back(std::move(group));
+    if (!detail::expandable(ptr)) {
+        ptr->m_filtered = true;
+        return *ptr;
+    }
+    detail::currentSuite = ptr;
+    body();
+    detail::currentSuite = parentSuite;
+    return *ptr;
+}
+
+detail::ExampleGroup& fdescribe(const std::string& groupname, std::function<void()> body) { return describe(groupname, body).only(); }
+detail::ExampleGroup& xdescribe(const std::string& groupname, std::function<void()> body) { return describe(groupname, body).skip(); }
+detail::ExampleGroup& describe(const std::string& groupname) { return xdescribe(groupname, []{}); }
+
+detail::Example& it(const std::string& examplename, std::function<void()> body) {
+    auto parentSuite = detail::currentSuite;
+    auto example = std::make_unique<detail::Example>(parentSuite, examplename, body);
+    detail::Example* ptr = example.get();
+    parentSuite->items.push_back(std::move(example));
+    return *ptr;
+}
+
+detail::Example& fit(const std::string& examplename, std::function<void()> body) { return it(examplename, body).only(); }
+detail::Example& xit(const std::string& examplename, std::function<void()> body) { return it(examplename, body).skip(); }
+detail::Example& it(const std::string& examplename) { return xit(examplename, []{}); }
+
+detail::Example& bench(const std::string& benchname, std::function<void()> body) {
+    auto& example = it(benchname, body);
+    example.m_bench = true;
+    return example;
+}
+
+detail::Example& fbench(const std::string& benchname, std::function<void()> body) { return bench(benchname, body).only(); }
+detail::Example& xbench(const std::string& benchname, std::function<void()> body) { return bench(benchname, body).skip(); }
+
+std::vector<size_t> geometric(size_t first, size_t last, double factor) {
+    std::vector<size_t> sizes;
+    for (auto size = first; size <= last; size = std::max<size_t>(size + 1, size * factor)) {
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+detail::Counters countEvents(const std::function<void()>& fn, Events events, std::source_location location) {
+    auto& counters = detail::PerfCounters::get();
+    auto begin = counters.read();
+    fn();
+    auto result = counters.since(begin);
+    if (!result.software) {
+        throw assertion_error("countEvents() needs perf_event_open(), which isn't permitted", location.file_name(), location.line());
+    }
+    if (events == Events::hardware && !result.hardware) {
+        throw assertion_error("countEvents() needs the hardware counters, which are unavailable, e.g. in containers", location.file_name(),
+                              location.line());
+    }
+    return result;
+}
 
 void beforeAll(std::function<void()> body) { detail::currentSuite->beforeAll.push_back(body); }
 void beforeEach(std::function<void()> body) { detail::currentSuite->beforeEach.push_back(body); }
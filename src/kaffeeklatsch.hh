@@ -4,15 +4,35 @@
 // https://stevenrbaker.com/tech/history-of-rspec.html
 
 #include <typeinfo>
+#include <type_traits>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
 #include <cstring>
 #include <exception>
 #include <format>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <print>
+#include <ranges>
+#include <source_location>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <optional>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <regex>
 
@@ -40,7 +60,7 @@ class is_streamable {
 };
 
 template <typename T>
-std::string to_str(T value) {
+std::string to_str(const T& value) {
     if constexpr (is_streamable<T>::value) {
         std::stringstream out;
         out << value;
@@ -53,20 +73,252 @@ inline std::string to_str(char value) { return std::format("'{}'", value); }
 inline std::string to_str(bool value) { return value ? "true" : "false"; }
 inline std::string to_str(const char* value) { return std::format("\"{}\"", value); }
 inline std::string to_str(const std::string& value) { return std::format("\"{}\"", value); }
+inline std::string to_str(std::string_view value) { return std::format("\"{}\"", value); }
 template <typename T>
-std::string to_str(std::optional<T> value) {
+std::string to_str(const std::optional<T>& value) {
     return value.has_value() ? to_str(value.value()) : "undefined";
 }
 
+namespace detail {
+// call fn once to warm up and then count times, returns the sorted durations
+std::vector<std::chrono::nanoseconds> sampleLatencies(const std::function<void()>& fn, unsigned count);
+// e.g. "12.3ns", "4.5us" or "6.7ms"
+std::string formatNanoseconds(double ns);
+
+// the heap allocations made by the calling thread, counted by the operator new of
+// kaffeeklatsch.allocations.cc once it is linked into the executable
+struct Allocations {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+};
+extern constinit thread_local Allocations allocations;
+extern bool allocationsTracked;
+// the allocations fn makes on the calling thread, none when they aren't tracked
+std::optional<Allocations> countAllocations(const std::function<void()>& fn);
+
+enum class Complexity { constant, logarithmic, linear, linearithmic, quadratic };
+// e.g. "O(n log n)"
+std::string formatComplexity(Complexity complexity);
+// the fastest of repeated calls of fn(size) in nanoseconds or it's number of allocations
+std::vector<double> measureScaling(const std::vector<size_t>& sizes, const std::function<void(size_t)>& fn, bool countingAllocations);
+// least squares fit of c·f(n) for each complexity, the root mean square error relative to the mean
+std::array<double, 5> fitComplexity(const std::vector<size_t>& sizes, const std::vector<double>& values);
+
+// the compiled pattern, the last 32 are cached per thread so that matching in a loop doesn't recompile it
+const std::regex& compiledRegex(std::string_view pattern);
+// 8-4-4-4-12 hex digits
+bool isUuid(std::string_view text);
+
+template <typename C>
+using element_t = std::remove_cvref_t<decltype(*std::begin(std::declval<C&>()))>;
+template <typename E>
+concept hashable = requires(const E& e) {
+    { std::hash<E>{}(e) } -> std::convertible_to<size_t>;
+};
+template <typename E>
+concept ordered = requires(const E& e) {
+    { e < e } -> std::convertible_to<bool>;
+};
+
+// counts the elements of a container by their address, hashed when there is a std::hash<E>
+// and ordered otherwise, so that the set matchers neither copy them nor compare each pair
+template <typename E>
+class Multiset {
+        static_assert(hashable<E> || ordered<E>, "the elements need a std::hash<> or an operator<");
+        struct Hash {
+                size_t operator()(const E* e) const { return std::hash<E>{}(*e); }
+        };
+        struct Equal {
+                bool operator()(const E* a, const E* b) const { return *a == *b; }
+        };
+        struct Less {
+                bool operator()(const E* a, const E* b) const { return *a < *b; }
+        };
+
+    public:
+        Multiset(size_t size) {
+            if constexpr (hashable<E>) {
+                m_counts.reserve(size);
+            }
+        }
+        // the number of equal elements after adding this one
+        size_t add(const E& element) { return ++m_counts[&element]; }
+        bool contains(const E& element) const {
+            auto it = m_counts.find(&element);
+            return it != m_counts.end() && it->second > 0;
+        }
+        // removes one of the equal elements, false when there is none left
+        bool take(const E& element) {
+            auto it = m_counts.find(&element);
+            if (it == m_counts.end() || it->second == 0) {
+                return false;
+            }
+            --it->second;
+            return true;
+        }
+
+    private:
+        std::conditional_t<hashable<E>, std::unordered_map<const E*, size_t, Hash, Equal>, std::map<const E*, size_t, Less>> m_counts;
+};
+
+// the index of the first element where a and b differ, size when there is none. integers, enums and
+// pointers are compared bytewise in blocks first, which memcmp() does vectorized
+template <typename E>
+size_t firstMismatch(const E* a, const E* b, size_t size) {
+    size_t i = 0;
+    if constexpr (std::is_scalar_v<E> && std::has_unique_object_representations_v<E>) {
+        constexpr size_t block = std::max<size_t>(1, 256 / sizeof(E));
+        while (i + block <= size && std::memcmp(a + i, b + i, block * sizeof(E)) == 0) {
+            i += block;
+        }
+    }
+    return std::mismatch(a + i, a + size, b + i).first - a;
+}
+
+template <typename V>
+concept string_like = std::same_as<V, std::string> || std::same_as<V, std::string_view>;
+template <typename V>
+concept contiguous = std::ranges::contiguous_range<const V> && std::ranges::sized_range<const V> && !string_like<V>;
+
+// strings longer than this are abbreviated or diffed in failure messages
+constexpr size_t maxInline = 64;
+// e.g. "\"abc...\" (1000 characters)"
+std::string abbreviate(std::string_view text);
+// a unified diff of expected and actual, which first differ at index first, as lines of the failure
+// message. the common prefix and suffix are skipped, the search for the shortest edit script only
+// looks at a window after the first difference and gives up after a few differences, so the cost
+// grows with the differences and not the size
+std::string formatDiff(size_t expectedSize, size_t actualSize, size_t first, const std::function<bool(size_t, size_t)>& equal,
+                       const std::function<std::string(bool actual, size_t index)>& element);
+// the window around the first difference of long strings or the diff of their lines
+std::string describeInequality(std::string_view actual, std::string_view expected);
+template <typename E>
+std::string describeInequality(std::span<const E> actual, std::span<const E> expected, size_t first) {
+    return std::format("expected {} elements to equal {} elements, first difference at index {} (- expected, + actual):", actual.size(), expected.size(),
+                       first) +
+           formatDiff(
+               expected.size(), actual.size(), first, [&](size_t i, size_t j) { return expected[i] == actual[j]; },
+               [&](bool isActual, size_t index) { return to_str(isActual ? actual[index] : expected[index]); });
+}
+
+// std::byte, char, uint8_t, ... in a std::vector, std::span, std::string, ...
+template <typename R>
+concept byte_range = std::ranges::contiguous_range<const R> && std::ranges::sized_range<const R> && sizeof(std::ranges::range_value_t<R>) == 1 &&
+                     std::is_trivially_copyable_v<std::ranges::range_value_t<R>>;
+template <byte_range R>
+std::span<const std::byte> asBytes(const R& range) {
+    return std::as_bytes(std::span(std::ranges::data(range), std::ranges::size(range)));
+}
+// the offset of needle in haystack, none when it's not in there
+std::optional<size_t> findBytes(std::span<const std::byte> haystack, std::span<const std::byte> needle);
+// e.g. "89 50 4e 47", up to 16 bytes
+std::string formatBytes(std::span<const std::byte> bytes);
+// a hexdump of the lines around first, each line in which expected and actual differ is shown twice
+// with the differing bytes marked
+std::string formatBytesDiff(std::span<const std::byte> expected, std::span<const std::byte> actual, size_t first);
+// a hexdump of the lines around offset, with the length bytes at offset marked
+std::string formatBytesAt(std::span<const std::byte> bytes, size_t offset, size_t length);
+
+template <typename R>
+concept floating_range = std::ranges::contiguous_range<const R> && std::ranges::sized_range<const R> &&
+                         (std::same_as<std::ranges::range_value_t<R>, float> || std::same_as<std::ranges::range_value_t<R>, double>);
+
+// the number of representable values between a and b, +0 and -0 are the same
+uint64_t ulpDistance(float a, float b);
+uint64_t ulpDistance(double a, double b);
+// the elements which aren't close, found in blocks of branch free loops which the compiler can vectorize
+struct Closeness {
+        size_t mismatches = 0;
+        // the mismatch furthest outside of it's tolerance
+        size_t worst = 0;
+        // the largest absolute difference or distance in ULPs of the mismatches
+        double maxError = 0;
+};
+Closeness compareClose(std::span<const float> actual, std::span<const float> expected, double abs, double rel);
+Closeness compareClose(std::span<const double> actual, std::span<const double> expected, double abs, double rel);
+Closeness compareUlps(std::span<const float> actual, std::span<const float> expected, uint64_t ulps);
+Closeness compareUlps(std::span<const double> actual, std::span<const double> expected, uint64_t ulps);
+
+// compare data with the next snapshot of the example being evaluated, see SnapshotStore
+void matchSnapshot(std::string_view data, bool text, const char* filename, unsigned line);
+
+// failure messages list only the first few elements, e.g. "1, 2, 3 and 97 more"
+constexpr size_t maxListed = 10;
+template <typename E>
+std::string formatElements(const std::vector<const E*>& elements) {
+    std::string out;
+    for (size_t i = 0; i < elements.size() && i < maxListed; ++i) {
+        if (i != 0) {
+            out += ", ";
+        }
+        out += to_str(*elements[i]);
+    }
+    if (elements.size() > maxListed) {
+        out += std::format(" and {} more", elements.size() - maxListed);
+    }
+    return out;
+}
+
+// the choices the generators of a property() make. they are drawn at random and recorded when
+// a case is generated so that a failing case can be shrunk by replaying simpler choices: 0 is
+// the simplest choice and a replay continues with 0 once the recorded choices are used up
+class Choices {
+    public:
+        // draw at random, size grows with the cases and bounds the length of containers
+        Choices(uint64_t seed, unsigned size) : m_state(seed), m_size(size) {}
+        // replay the choices
+        explicit Choices(std::vector<uint64_t> replay) : m_replay(std::move(replay)), m_replaying(true) {}
+        // a choice in 0..max, drawn uniformly but with the edges 0 and max more often
+        uint64_t draw(uint64_t max);
+        // whether to add another element to a container
+        bool more();
+        const std::vector<uint64_t>& drawn() const { return m_drawn; }
+
+    private:
+        // splitmix64
+        uint64_t next();
+        uint64_t m_state = 0;
+        unsigned m_size = 0;
+        std::vector<uint64_t> m_replay;
+        bool m_replaying = false;
+        std::vector<uint64_t> m_drawn;
+};
+
+// thrown by a generator which can't find a value, e.g. because gen::filter() rejects too many
+struct Unsatisfiable : std::runtime_error {
+        using runtime_error::runtime_error;
+};
+
+// like to_str() but lists the elements of containers, e.g. "{1, 2, 3}"
+template <typename T>
+std::string formatValue(const T& value) {
+    if constexpr (std::ranges::range<const T> && !is_streamable<T>::value) {
+        std::string out = "{";
+        for (const auto& element : value) {
+            if (out.size() > 1) {
+                out += ", ";
+            }
+            out += formatValue(element);
+        }
+        return out + "}";
+    } else {
+        return to_str(value);
+    }
+}
+}  // namespace detail
+
+// T is a reference for lvalues, which aren't copied, and the value itself for temporaries
 template <typename T>
 class Assertion {
+        using Value = std::remove_cvref_t<T>;
         T m_value;
         bool m_negate = false;
+        unsigned m_samples = 100;
         const char* filename;
         unsigned line;
 
     public:
-        Assertion(T value, const char* filename, unsigned line) : m_value(value), filename(filename), line(line) {}
+        Assertion(T&& value, const char* filename, unsigned line) : m_value(std::forward<T>(value)), filename(filename), line(line) {}
         Assertion() = delete;
         Assertion(const Assertion&) = delete;
         Assertion(Assertion&&) = delete;
@@ -82,21 +334,29 @@ class Assertion {
         //
         // eq
         //
-        Assertion& eq(T value) {
-            if (m_negate) {
-                if (m_value == value) {
-                    throw assertion_error(std::format("expected {} to not equal {}", to_str(m_value), to_str(value)), filename, line);
+        Assertion& eq(const Value& value) {
+            if constexpr (detail::string_like<Value>) {
+                return eqString(value);
+            } else if constexpr (detail::contiguous<Value>) {
+                return eqSequence(value);
+            } else if constexpr (std::equality_comparable<Value>) {
+                if (m_negate) {
+                    if (m_value == value) {
+                        throw assertion_error(std::format("expected {} to not equal {}", to_str(m_value), to_str(value)), filename, line);
+                    }
+                } else {
+                    if (m_value != value) {
+                        throw assertion_error(std::format("expected {} to equal {}", to_str(m_value), to_str(value)), filename, line);
+                    }
                 }
+                m_negate = false;
+                return *this;
             } else {
-                if (m_value != value) {
-                    throw assertion_error(std::format("expected {} to equal {}", to_str(m_value), to_str(value)), filename, line);
-                }
+                static_assert(!sizeof(Value), "eq() needs a string, a contiguous range or a type with operator==");
             }
-            m_negate = false;
-            return *this;
         }
-        Assertion& equal(T value) { return eq(value); }
-        Assertion& equals(T value) { return eq(value); }
+        Assertion& equal(const Value& value) { return eq(value); }
+        Assertion& equals(const Value& value) { return eq(value); }
 
         Assertion& undefined() {
             if (m_value.has_value()) {
@@ -214,29 +474,27 @@ class Assertion {
         //
         // regex
         //
-        Assertion& match(std::regex re) {
-            std::cmatch m;
+        Assertion& match(const std::regex& re) {
             if (m_negate) {
-                if (std::regex_match(m_value, m, re)) {
+                if (matches(re)) {
                     throw assertion_error(std::format("expected {} to not match regex", to_str(m_value)), filename, line);
                 }
             } else {
-                if (!std::regex_match(m_value, m, re)) {
+                if (!matches(re)) {
                     throw assertion_error(std::format("expected {} to match regex", to_str(m_value)), filename, line);
                 }
             }
             m_negate = false;
             return *this;
         }
-        Assertion& match(std::string pattern) {
-            std::regex re(pattern);
-            std::cmatch m;
+        Assertion& match(std::string_view pattern) {
+            auto& re = detail::compiledRegex(pattern);
             if (m_negate) {
-                if (std::regex_match(m_value, m, re)) {
+                if (matches(re)) {
                     throw assertion_error(std::format("expected {} to not match /{}/", to_str(m_value), pattern), filename, line);
                 }
             } else {
-                if (!std::regex_match(m_value, m, re)) {
+                if (!matches(re)) {
                     throw assertion_error(std::format("expected {} to match /{}/", to_str(m_value), pattern), filename, line);
                 }
             }
@@ -244,14 +502,12 @@ class Assertion {
             return *this;
         }
         Assertion& uuid() {
-            std::regex re("^[[:xdigit:]]{8}-[[:xdigit:]]{4}-[[:xdigit:]]{4}-[[:xdigit:]]{4}-[[:xdigit:]]{12}$");
-            std::cmatch m;
             if (m_negate) {
-                if (std::regex_match(m_value, m, re)) {
+                if (detail::isUuid(m_value)) {
                     throw assertion_error(std::format("expected {} to not be a UUID", to_str(m_value)), filename, line);
                 }
             } else {
-                if (!std::regex_match(m_value, m, re)) {
+                if (!detail::isUuid(m_value)) {
                     throw assertion_error(std::format("expected {} to be a UUID", to_str(m_value)), filename, line);
                 }
             }
@@ -309,6 +565,366 @@ class Assertion {
             return *this;
         }
         Assertion& contains(auto value) { return contain(value); }
+        // every element of expected, hashed or ordered instead of a scan per element
+        template <typename R>
+        Assertion& containAll(const R& expected) {
+            using E = detail::element_t<Value>;
+            static_assert(std::is_same_v<detail::element_t<R>, E>, "expected needs the same element type");
+            auto actual = members();
+            std::vector<const E*> missing;
+            size_t count = 0;
+            for (auto& element : expected) {
+                ++count;
+                if (!actual.contains(element)) {
+                    missing.push_back(&element);
+                }
+            }
+            if (m_negate) {
+                if (missing.empty()) {
+                    throw assertion_error(std::format("expected to not contain all of {} elements", count), filename, line);
+                }
+            } else {
+                if (!missing.empty()) {
+                    throw assertion_error(std::format("expected to contain all of {} elements but {} are missing: {}", count, missing.size(),
+                                                      detail::formatElements(missing)),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        template <typename V = Value, typename E = detail::element_t<V>>
+        Assertion& containAll(std::initializer_list<std::type_identity_t<E>> expected) {
+            return containAll(std::span<const E>(expected.begin(), expected.size()));
+        }
+        template <typename R>
+        Assertion& containAny(const R& expected) {
+            using E = detail::element_t<Value>;
+            static_assert(std::is_same_v<detail::element_t<R>, E>, "expected needs the same element type");
+            auto actual = members();
+            std::vector<const E*> found;
+            size_t count = 0;
+            for (auto& element : expected) {
+                ++count;
+                if (actual.contains(element)) {
+                    found.push_back(&element);
+                }
+            }
+            if (m_negate) {
+                if (!found.empty()) {
+                    throw assertion_error(std::format("expected to not contain any of {} elements but contains {}: {}", count, found.size(),
+                                                      detail::formatElements(found)),
+                                          filename, line);
+                }
+            } else {
+                if (found.empty()) {
+                    throw assertion_error(std::format("expected to contain any of {} elements but contains none", count), filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        template <typename V = Value, typename E = detail::element_t<V>>
+        Assertion& containAny(std::initializer_list<std::type_identity_t<E>> expected) {
+            return containAny(std::span<const E>(expected.begin(), expected.size()));
+        }
+        // the same elements, each as often, in any order
+        template <typename R>
+        Assertion& haveSameMembers(const R& expected) {
+            using E = detail::element_t<Value>;
+            static_assert(std::is_same_v<detail::element_t<R>, E>, "expected needs the same element type");
+            auto actual = members();
+            std::vector<const E*> missing;
+            for (auto& element : expected) {
+                if (!actual.take(element)) {
+                    missing.push_back(&element);
+                }
+            }
+            // what's left over in actual, in it's order
+            std::vector<const E*> extra;
+            for (auto& element : m_value) {
+                if (actual.take(element)) {
+                    extra.push_back(&element);
+                }
+            }
+            bool same = missing.empty() && extra.empty();
+            if (m_negate) {
+                if (same) {
+                    throw assertion_error("expected to not have the same members", filename, line);
+                }
+            } else {
+                if (!same) {
+                    std::string message = "expected the same members but";
+                    if (!missing.empty()) {
+                        message += std::format(" {} are missing: {}", missing.size(), detail::formatElements(missing));
+                    }
+                    if (!extra.empty()) {
+                        message += std::format("{} {} are extra: {}", missing.empty() ? "" : ";", extra.size(), detail::formatElements(extra));
+                    }
+                    throw assertion_error(message, filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        template <typename V = Value, typename E = detail::element_t<V>>
+        Assertion& haveSameMembers(std::initializer_list<std::type_identity_t<E>> expected) {
+            return haveSameMembers(std::span<const E>(expected.begin(), expected.size()));
+        }
+        // ascending by operator<, equal neighbours are allowed
+        Assertion& beSorted() {
+            auto begin = std::begin(m_value), end = std::end(m_value);
+            auto it = std::is_sorted_until(begin, end);
+            if (m_negate) {
+                if (it == end) {
+                    throw assertion_error("expected to not be sorted", filename, line);
+                }
+            } else {
+                if (it != end) {
+                    throw assertion_error(std::format("expected to be sorted but {} at index {} is less than {}", to_str(*it), std::distance(begin, it),
+                                                      to_str(*std::prev(it))),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        Assertion& beUnique() {
+            using E = detail::element_t<Value>;
+            detail::Multiset<E> actual(m_value.size());
+            std::vector<const E*> duplicates;
+            for (auto& element : m_value) {
+                if (actual.add(element) == 2) {
+                    duplicates.push_back(&element);
+                }
+            }
+            if (m_negate) {
+                if (duplicates.empty()) {
+                    throw assertion_error("expected to not be unique", filename, line);
+                }
+            } else {
+                if (!duplicates.empty()) {
+                    throw assertion_error(std::format("expected to be unique but {} are duplicated: {}", duplicates.size(), detail::formatElements(duplicates)),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+
+        //
+        // floating point, within an absolute or relative tolerance or a number of units in the last place
+        //
+        Assertion& closeTo(double expected, double abs, double rel = 0)
+            requires std::floating_point<Value>
+        {
+            double error = std::abs(m_value - expected);
+            double tolerance = std::max(abs, rel * std::max(std::abs(double(m_value)), std::abs(expected)));
+            bool close = m_value == expected || error <= tolerance;
+            if (m_negate) {
+                if (close) {
+                    throw assertion_error(std::format("expected {} to not be close to {}", m_value, expected), filename, line);
+                }
+            } else {
+                if (!close) {
+                    throw assertion_error(std::format("expected {} to be close to {} but differs by {}, more than {}", m_value, expected, error, tolerance),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        template <detail::floating_range R>
+        Assertion& closeTo(const R& expected, double abs, double rel = 0) {
+            auto [actualValues, expectedValues] = floats(expected);
+            detail::Closeness closeness;
+            if (actualValues.size() == expectedValues.size()) {
+                closeness = detail::compareClose(actualValues, expectedValues, abs, rel);
+            }
+            return closeTo(actualValues, expectedValues, closeness, std::format("abs {} or rel {}", abs, rel), "");
+        }
+        Assertion& withinUlps(Value expected, uint64_t ulps)
+            requires std::floating_point<Value>
+        {
+            auto distance = detail::ulpDistance(m_value, expected);
+            bool close = !std::isnan(m_value) && !std::isnan(expected) && distance <= ulps;
+            if (m_negate) {
+                if (close) {
+                    throw assertion_error(std::format("expected {} to not be within {} ULPs of {}", m_value, ulps, expected), filename, line);
+                }
+            } else {
+                if (!close) {
+                    throw assertion_error(std::format("expected {} to be within {} ULPs of {} but is {} ULPs away", m_value, ulps, expected, distance),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        template <detail::floating_range R>
+        Assertion& withinUlps(const R& expected, uint64_t ulps) {
+            auto [actualValues, expectedValues] = floats(expected);
+            detail::Closeness closeness;
+            if (actualValues.size() == expectedValues.size()) {
+                closeness = detail::compareUlps(actualValues, expectedValues, ulps);
+            }
+            return closeTo(actualValues, expectedValues, closeness, std::format("{} ULPs", ulps), " ULPs");
+        }
+
+        //
+        // byte buffers, compared with memcmp() and shown as hexdump
+        //
+        template <detail::byte_range R>
+        Assertion& equalBytes(const R& expected) {
+            auto actualBytes = detail::asBytes(m_value), expectedBytes = detail::asBytes(expected);
+            bool equal = actualBytes.size() == expectedBytes.size() && std::memcmp(actualBytes.data(), expectedBytes.data(), actualBytes.size()) == 0;
+            if (m_negate) {
+                if (equal) {
+                    throw assertion_error(std::format("expected {} bytes to not equal {} bytes", actualBytes.size(), expectedBytes.size()), filename, line);
+                }
+            } else {
+                if (!equal) {
+                    auto first = detail::firstMismatch(actualBytes.data(), expectedBytes.data(), std::min(actualBytes.size(), expectedBytes.size()));
+                    throw assertion_error(std::format("expected {} bytes to equal {} bytes, first difference at offset 0x{:x} (- expected, + actual):",
+                                                      actualBytes.size(), expectedBytes.size(), first) +
+                                              detail::formatBytesDiff(expectedBytes, actualBytes, first),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        Assertion& equalBytes(std::initializer_list<uint8_t> expected) { return equalBytes(std::span(expected.begin(), expected.size())); }
+        template <detail::byte_range R>
+        Assertion& startWithBytes(const R& prefix) {
+            auto actualBytes = detail::asBytes(m_value), prefixBytes = detail::asBytes(prefix);
+            auto head = actualBytes.first(std::min(actualBytes.size(), prefixBytes.size()));
+            bool starts = head.size() == prefixBytes.size() && std::memcmp(head.data(), prefixBytes.data(), head.size()) == 0;
+            if (m_negate) {
+                if (starts) {
+                    throw assertion_error(std::format("expected {} bytes to not start with {}", actualBytes.size(), detail::formatBytes(prefixBytes)), filename,
+                                          line);
+                }
+            } else {
+                if (!starts) {
+                    auto first = detail::firstMismatch(head.data(), prefixBytes.data(), head.size());
+                    throw assertion_error(std::format("expected {} bytes to start with {}, first difference at offset 0x{:x} (- expected, + actual):",
+                                                      actualBytes.size(), detail::formatBytes(prefixBytes), first) +
+                                              detail::formatBytesDiff(prefixBytes, head, first),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        Assertion& startWithBytes(std::initializer_list<uint8_t> prefix) { return startWithBytes(std::span(prefix.begin(), prefix.size())); }
+        template <detail::byte_range R>
+        Assertion& containBytes(const R& needle) {
+            auto actualBytes = detail::asBytes(m_value), needleBytes = detail::asBytes(needle);
+            auto offset = detail::findBytes(actualBytes, needleBytes);
+            if (m_negate) {
+                if (offset) {
+                    throw assertion_error(std::format("expected {} bytes to not contain {} but found them at offset 0x{:x}:", actualBytes.size(),
+                                                      detail::formatBytes(needleBytes), *offset) +
+                                              detail::formatBytesAt(actualBytes, *offset, needleBytes.size()),
+                                          filename, line);
+                }
+            } else {
+                if (!offset) {
+                    throw assertion_error(std::format("expected {} bytes to contain {}", actualBytes.size(), detail::formatBytes(needleBytes)), filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        Assertion& containBytes(std::initializer_list<uint8_t> needle) { return containBytes(std::span(needle.begin(), needle.size())); }
+
+        //
+        // snapshots, recorded by the first run and compared with in later ones
+        //
+        Assertion& matchSnapshot() {
+            if (m_negate) {
+                throw assertion_error("matchSnapshot() can't be negated", filename, line);
+            }
+            if constexpr (detail::byte_range<Value>) {
+                auto bytes = detail::asBytes(m_value);
+                detail::matchSnapshot({reinterpret_cast<const char*>(bytes.data()), bytes.size()}, std::same_as<std::ranges::range_value_t<Value>, char>,
+                                      filename, line);
+            } else {
+                // as shown in failure messages, which list the elements of containers
+                detail::matchSnapshot(detail::formatValue(m_value), true, filename, line);
+            }
+            return *this;
+        }
+
+        //
+        // latency of a callable, which is called repeatedly to compare a percentile of the durations
+        //
+        Assertion& samples(unsigned count) {
+            m_samples = count;
+            return *this;
+        }
+        // the 99th percentile, so that a single hiccup of the scheduler doesn't fail it
+        Assertion& completeWithin(std::chrono::nanoseconds limit) { return latency(99, limit, true); }
+        Assertion& haveP50Below(std::chrono::nanoseconds limit) { return latency(50, limit, false); }
+        Assertion& haveP90Below(std::chrono::nanoseconds limit) { return latency(90, limit, false); }
+        Assertion& haveP99Below(std::chrono::nanoseconds limit) { return latency(99, limit, false); }
+        Assertion& havePercentileBelow(double percentile, std::chrono::nanoseconds limit) { return latency(percentile, limit, false); }
+
+        //
+        // heap allocations of a callable on the calling thread, needs kaffeeklatsch.allocations.cc
+        //
+        Assertion& allocate() {
+            auto allocations = countAllocations();
+            if (m_negate) {
+                if (allocations.count != 0) {
+                    throw assertion_error(std::format("expected to not allocate but allocated {} times ({} bytes)", allocations.count, allocations.bytes),
+                                          filename, line);
+                }
+            } else {
+                if (allocations.count == 0) {
+                    throw assertion_error("expected to allocate", filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        Assertion& allocateAtMost(uint64_t count) {
+            auto allocations = countAllocations();
+            if (m_negate) {
+                if (allocations.count <= count) {
+                    throw assertion_error(std::format("expected more than {} allocations but allocated {} times ({} bytes)", count, allocations.count,
+                                                      allocations.bytes),
+                                          filename, line);
+                }
+            } else {
+                if (allocations.count > count) {
+                    throw assertion_error(std::format("expected at most {} allocations but allocated {} times ({} bytes)", count, allocations.count,
+                                                      allocations.bytes),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        Assertion& allocateAtMostBytes(uint64_t bytes) {
+            auto allocations = countAllocations();
+            if (m_negate) {
+                if (allocations.bytes <= bytes) {
+                    throw assertion_error(std::format("expected to allocate more than {} bytes but allocated {} bytes ({} times)", bytes, allocations.bytes,
+                                                      allocations.count),
+                                          filename, line);
+                }
+            } else {
+                if (allocations.bytes > bytes) {
+                    throw assertion_error(std::format("expected to allocate at most {} bytes but allocated {} bytes ({} times)", bytes, allocations.bytes,
+                                                      allocations.count),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
 
         //
         // not
@@ -371,13 +987,187 @@ class Assertion {
             }
             return *this;
         }
+
+    private:
+        template <detail::floating_range R>
+        auto floats(const R& expected) const {
+            using F = std::ranges::range_value_t<const Value>;
+            static_assert(std::is_same_v<std::ranges::range_value_t<R>, F>, "expected needs the same element type");
+            return std::pair{std::span<const F>(std::ranges::data(m_value), std::ranges::size(m_value)),
+                             std::span<const F>(std::ranges::data(expected), std::ranges::size(expected))};
+        }
+        template <typename F>
+        Assertion& closeTo(std::span<const F> actual, std::span<const F> expected, const detail::Closeness& closeness, const std::string& tolerance,
+                           const char* unit) {
+            bool close = actual.size() == expected.size() && closeness.mismatches == 0;
+            if (m_negate) {
+                if (close) {
+                    throw assertion_error(std::format("expected {} elements to not be close to {} elements", actual.size(), expected.size()), filename, line);
+                }
+            } else {
+                if (actual.size() != expected.size()) {
+                    throw assertion_error(std::format("expected {} elements to be close to {} elements", actual.size(), expected.size()), filename, line);
+                }
+                if (!close) {
+                    auto i = closeness.worst;
+                    throw assertion_error(std::format("expected {} elements to be close but {} differ by more than {}, the worst at index {} with {} instead "
+                                                      "of {}, the max error is {}{}",
+                                                      actual.size(), closeness.mismatches, tolerance, i, actual[i], expected[i], closeness.maxError, unit),
+                                          filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        // long strings and sequences are compared up to the first mismatch and only the difference is reported
+        Assertion& eqString(const Value& value) {
+            std::string_view actual = m_value, expected = value;
+            if (m_negate) {
+                if (actual == expected) {
+                    throw assertion_error(std::format("expected {} to not equal {}", detail::abbreviate(actual), detail::abbreviate(expected)), filename, line);
+                }
+            } else {
+                if (actual != expected) {
+                    throw assertion_error(detail::describeInequality(actual, expected), filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        Assertion& eqSequence(const Value& value) {
+            using E = std::ranges::range_value_t<const Value>;
+            std::span<const E> actual(std::ranges::data(m_value), std::ranges::size(m_value)), expected(std::ranges::data(value), std::ranges::size(value));
+            auto first = detail::firstMismatch(actual.data(), expected.data(), std::min(actual.size(), expected.size()));
+            bool equal = actual.size() == expected.size() && first == actual.size();
+            if (m_negate) {
+                if (equal) {
+                    throw assertion_error(actual.size() <= detail::maxListed
+                                              ? std::format("expected {} to not equal {}", to_str(m_value), to_str(value))
+                                              : std::format("expected {} elements to not equal {} elements", actual.size(), expected.size()),
+                                          filename, line);
+                }
+            } else {
+                if (!equal) {
+                    throw assertion_error(detail::describeInequality(actual, expected, first), filename, line);
+                }
+            }
+            m_negate = false;
+            return *this;
+        }
+        auto members() const {
+            detail::Multiset<detail::element_t<Value>> multiset(m_value.size());
+            for (auto& element : m_value) {
+                multiset.add(element);
+            }
+            return multiset;
+        }
+        // const char*, std::string and std::string_view
+        bool matches(const std::regex& re) const {
+            std::string_view text = m_value;
+            return std::regex_match(text.begin(), text.end(), re);
+        }
+        detail::Allocations countAllocations() {
+            auto allocations = detail::countAllocations([this] { m_value(); });
+            if (!allocations) {
+                throw assertion_error("allocations are not tracked, link kaffeeklatsch.allocations.cc", filename, line);
+            }
+            return *allocations;
+        }
+        // nearest rank percentile, within includes the limit
+        Assertion& latency(double percentile, std::chrono::nanoseconds limit, bool within) {
+            auto durations = detail::sampleLatencies([this] { m_value(); }, std::max(1u, m_samples));
+            auto rank = std::clamp<size_t>(std::ceil(percentile / 100 * durations.size()), 1, durations.size());
+            auto value = durations[rank - 1];
+            bool okay = within ? value <= limit : value < limit;
+            if (okay == m_negate) {
+                throw assertion_error(std::format("expected {} latency {} to {}be {} {} ({} samples)", std::format("p{}", percentile),
+                                                  detail::formatNanoseconds(value.count()),
+                                                  m_negate ? "not " : "", within ? "within" : "below", detail::formatNanoseconds(limit.count()),
+                                                  durations.size()),
+                                      filename, line);
+            }
+            m_negate = false;
+            return *this;
+        }
 };
 
-#define expect(V) _expect(V, __FILE__, __LINE__)
+// expect(sizes, fn).to.scale.linearly(): calls fn(n) for each of the sizes and fits the
+// durations to each complexity. neighbours like O(n) and O(n log n) are hard to tell from
+// measurements, the expected complexity passes when it's error is close to the best one's
+template <typename F>
+class Scaling {
+        std::vector<size_t> sizes;
+        F fn;
+        bool m_negate = false;
+        bool m_allocations = false;
+        const char* filename;
+        unsigned line;
+
+    public:
+        Scaling(std::vector<size_t> sizes, F fn, const char* filename, unsigned line) : sizes(std::move(sizes)), fn(fn), filename(filename), line(line) {}
+        Scaling(const Scaling&) = delete;
+        Scaling& operator=(const Scaling&) = delete;
+
+        Scaling &to{*this}, &scale{*this}, &does{*this};
+
+        // fit the number of heap allocations instead of the durations, needs kaffeeklatsch.allocations.cc
+        Scaling& allocations() {
+            m_allocations = true;
+            return *this;
+        }
+        Scaling& not_() {
+            m_negate = !m_negate;
+            return *this;
+        }
+        Scaling& constant() { return complexity(detail::Complexity::constant); }
+        Scaling& logarithmically() { return complexity(detail::Complexity::logarithmic); }
+        Scaling& linearly() { return complexity(detail::Complexity::linear); }
+        Scaling& linearithmically() { return complexity(detail::Complexity::linearithmic); }
+        Scaling& quadratically() { return complexity(detail::Complexity::quadratic); }
+
+        Scaling& complexity(detail::Complexity expected) {
+            if (sizes.size() < 3) {
+                throw assertion_error("expected at least 3 sizes to fit the complexity", filename, line);
+            }
+            if (m_allocations && !detail::allocationsTracked) {
+                throw assertion_error("allocations are not tracked, link kaffeeklatsch.allocations.cc", filename, line);
+            }
+            auto values = detail::measureScaling(sizes, fn, m_allocations);
+            auto errors = detail::fitComplexity(sizes, values);
+            auto best = static_cast<detail::Complexity>(std::min_element(errors.begin(), errors.end()) - errors.begin());
+            constexpr double tolerance = 0.1;
+            bool fits = errors[static_cast<size_t>(expected)] <= errors[static_cast<size_t>(best)] + tolerance;
+            if (fits == m_negate) {
+                std::string rms;
+                for (size_t i = 0; i < errors.size(); ++i) {
+                    rms += std::format("{}{} {:.1f}%", i ? ", " : "", detail::formatComplexity(static_cast<detail::Complexity>(i)), errors[i] * 100);
+                }
+                throw assertion_error(std::format("expected {} to {}scale with {} but they fit {} best (rms error {})", m_allocations ? "allocations" : "durations",
+                                                  m_negate ? "not " : "", detail::formatComplexity(expected), detail::formatComplexity(best), rms),
+                                      filename, line);
+            }
+            m_negate = false;
+            return *this;
+        }
+};
 
+// first, first·factor, first·factor², ... up to last
+std::vector<size_t> geometric(size_t first, size_t last, double factor = 2);
+
+#define expect(...) _expect(__VA_ARGS__, __FILE__, __LINE__)
+
+// lvalues are referenced and temporaries are moved into the assertion, arrays and functions decay
 template <typename T>
-Assertion<T> _expect(T value, const char* filename, unsigned line) {
-    return Assertion(value, filename, line);
+auto _expect(T&& value, const char* filename, unsigned line) {
+    if constexpr (std::is_array_v<std::remove_reference_t<T>> || std::is_function_v<std::remove_reference_t<T>>) {
+        return Assertion<std::decay_t<T>>(value, filename, line);
+    } else {
+        return Assertion<T>(std::forward<T>(value), filename, line);
+    }
+}
+template <typename F>
+Scaling<F> _expect(std::vector<size_t> sizes, F fn, const char* filename, unsigned line) {
+    return Scaling(std::move(sizes), fn, filename, line);
 }
 
 namespace detail {
@@ -391,19 +1181,381 @@ struct Statistics {
         unsigned numFailedTests = 0;
         unsigned numTotalTestSuites = 0;
         std::chrono::nanoseconds totalDuration = 0ns;
+
+        Statistics& operator+=(const Statistics& other) {
+            numTotalTests += other.numTotalTests;
+            numPassedTests += other.numPassedTests;
+            numSkippedTests += other.numSkippedTests;
+            numFailedTests += other.numFailedTests;
+            numTotalTestSuites += other.numTotalTestSuites;
+            totalDuration += other.totalDuration;
+            return *this;
+        }
+};
+
+class Reporter;
+class BaselineDatabase;
+class SnapshotStore;
+
+struct Options {
+        // number of threads evaluating examples, 1 evaluates on the calling thread
+        unsigned jobs = 1;
+        // evaluate examples in forked worker processes, jobs is the number of workers
+        bool isolate = false;
+        // evaluate only the shard-th of shards disjoint parts of the examples (1-based)
+        unsigned shard = 1;
+        unsigned shards = 1;
+        // file to keep the example's durations in, empty to disable (the default)
+        std::string timings;
+        // file to keep the ids of failed examples in, empty to disable (the default)
+        std::string status;
+        // evaluate only the examples with these ids, e.g. the ones which failed in the last run
+        std::optional<std::unordered_set<uint64_t>> only;
+        // evaluate only the first of them in declaration order
+        bool onlyFirst = false;
+        // evaluate only examples on one of these paths ("group > group > example"), the bodies
+        // of groups which are not on one of the paths are not executed
+        std::vector<std::string> paths;
+        // evaluate only examples whose path matches this regular expression
+        std::string grep;
+        // fail examples which take longer, 0 disables the timeout. generous by default so that
+        // slow but working examples pass while a hung one can't block a ci run forever
+        std::chrono::nanoseconds timeout = std::chrono::seconds(60);
+        // end the run when an example doesn't return this long after it's timeout, see run()
+        std::chrono::nanoseconds grace = std::chrono::seconds(10);
+        // "<name>[:<destination>]" with name console, junit, jsonl or tap and destination a file,
+        // "-" for stdout (the default) or "&<n>" for file descriptor n
+        std::vector<std::string> reporters;
+        // file to write a Chrome trace of the examples, hooks and groups to, empty to disable
+        std::string trace;
+        // take the perf_event_open() counters around each example, see Counters
+        bool counters = false;
+        // print the examples which used the most of this metric, see TopReporter, empty to disable
+        std::string top;
+        unsigned topCount = 10;
+        // file with the samples of the benchmarks in a previous run to compare with, empty to disable
+        std::string baseline;
+        // write the samples to the baseline instead of comparing with it
+        bool saveBaseline = false;
+        // fail benchmarks which are slower than the baseline with a p-value below this
+        double significance = 0.01;
+        // and only when they are slower by more than this fraction of the baseline's median, as
+        // with many samples even a shift within the noise of the machine is significant
+        double regressionThreshold = 0.05;
+        // the loaded baseline, may be null
+        const BaselineDatabase* baselines = nullptr;
+        // file to keep the snapshots of matchSnapshot() in, empty to disable
+        std::string snapshots = ".kaffeeklatsch-snapshots";
+        // replace the snapshots which don't match instead of failing
+        bool updateSnapshots = false;
+        // the loaded snapshots, may be null
+        SnapshotStore* snapshotStore = nullptr;
+        // the number of cases of properties which don't set their own
+        unsigned cases = 100;
+        // the seed the cases of the properties are drawn with, random when not set
+        std::optional<uint64_t> seed;
+        // receives the results while evaluating, may be null
+        Reporter* reporter = nullptr;
 };
 
+// parse the command line, returns false and prints a message on error
+bool parseOptions(int argc, char* argv[], Options* options);
 
+class ThreadPool;
+struct Item;
 struct ExampleGroup;
 
+// the durations an example took in previous runs
+struct Timing {
+        float mean = 0;  // exponentially weighted moving average and variance in nanoseconds
+        float variance = 0;
+        uint32_t count = 0;
+        void add(std::chrono::nanoseconds duration);
+        // whether duration is significantly above the history
+        bool regressed(std::chrono::nanoseconds duration) const;
+};
+
+// the timings of all examples, keyed by Item::m_id
+class TimingDatabase {
+    public:
+        bool load(const std::string& filename);
+        bool save(const std::string& filename) const;
+        bool empty() const { return timings.empty(); }
+        const Timing* find(uint64_t id) const;
+        void add(uint64_t id, std::chrono::nanoseconds duration) { timings[id].add(duration); }
+
+    private:
+        std::unordered_map<uint64_t, Timing> timings;
+};
+
+// the ids of the examples which failed when they were evaluated the last time
+class StatusDatabase {
+    public:
+        bool load(const std::string& filename);
+        bool save(const std::string& filename) const;
+        const std::unordered_set<uint64_t>& failures() const { return failed; }
+        // update with the examples evaluated in the tree and forget the ids not in the tree
+        void update(ExampleGroup* root);
+
+    private:
+        std::unordered_set<uint64_t> failed;
+        std::unordered_map<uint64_t, std::string> paths;  // for humans reading the file
+};
+
+struct Example;
+class Sequencer;
+
+// the result of bench(), times are in nanoseconds per operation
+struct Benchmark {
+        static constexpr unsigned maxSamples = 10;
+        uint64_t iterations = 0;  // per sample
+        uint32_t samples = 0;     // 0 when not measured
+        double mean = 0;
+        double median = 0;
+        double stddev = 0;
+        double min = 0;
+        std::array<double, maxSamples> values = {};  // the samples, sorted
+};
+
+// what an example used from getrusage(), of the thread evaluating it where supported
+struct Resources {
+        std::chrono::nanoseconds user = 0ns;    // cpu time
+        std::chrono::nanoseconds system = 0ns;  // cpu time
+        int64_t maxRss = 0;                     // bytes the peak resident set size of the process grew by
+        int64_t minorFaults = 0;
+        int64_t majorFaults = 0;
+        int64_t voluntarySwitches = 0;
+        int64_t involuntarySwitches = 0;
+};
+
+// perf_event_open() counters of the thread evaluating an example. the hardware
+// counters are often not accessible, e.g. in containers, then only the software
+// counters are taken
+struct Counters {
+        bool software = false;  // whether the counters below were taken
+        bool hardware = false;
+        uint64_t instructions = 0;
+        uint64_t cycles = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t branchMisses = 0;
+        std::chrono::nanoseconds taskClock = 0ns;
+        uint64_t pageFaults = 0;
+        uint64_t contextSwitches = 0;
+};
+// cleared to take the counters of the calling thread as if perf_event_open() refused them, e.g. to
+// test without them
+extern thread_local bool softwareEventsPermitted, hardwareEventsPermitted;
+
+// the samples of the benchmarks in a previous run, keyed by Item::m_id
+class BaselineDatabase {
+    public:
+        bool load(const std::string& filename);
+        bool save(const std::string& filename) const;
+        const std::vector<double>* find(uint64_t id) const;
+        // replace the samples of the benchmarks measured in the tree and keep the others
+        void update(ExampleGroup* root);
+
+    private:
+        struct Entry {
+                std::vector<double> samples;
+                std::string path;  // for humans reading the file
+        };
+        std::unordered_map<uint64_t, Entry> entries;
+};
+
+// the snapshots of matchSnapshot(), keyed by the id of the example and their number within
+// it. the file is memory mapped and a snapshot is only read when it's hash differs, so large
+// snapshots which didn't change are neither read nor copied
+class SnapshotStore {
+    public:
+        SnapshotStore() = default;
+        SnapshotStore(const SnapshotStore&) = delete;
+        SnapshotStore& operator=(const SnapshotStore&) = delete;
+        ~SnapshotStore();
+        bool load(const std::string& filename);
+        bool save(const std::string& filename) const;
+        // record data when there is no snapshot yet or update is set, the message when it differs
+        std::optional<std::string> match(uint64_t id, unsigned index, std::string_view data, bool text);
+        // forget the snapshots which examples passing in the tree didn't match anymore and, when
+        // the whole tree was declared, those of examples which don't exist anymore
+        void prune(ExampleGroup* root);
+        // the snapshots recorded since the last call, for a forked worker to pass them on
+        std::string takeRecorded();
+        void addRecorded(std::string_view recorded);
+        bool changed() const { return m_changed; }
+        bool update = false;
+
+    private:
+        struct Entry {
+                uint64_t hash = 0;
+                std::string_view data;  // into the mapped file or owned
+                std::string owned;
+        };
+        std::mutex mutex;
+        // keyed by Item::m_id and the index of the snapshot within the example
+        std::map<std::pair<uint64_t, unsigned>, Entry> entries;
+        std::vector<std::pair<uint64_t, unsigned>> recorded;
+        bool m_changed = false;
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+};
+
+// one-sided p-value of the Mann-Whitney U test for the values in a being greater than those in b
+double mannWhitneyU(const std::vector<double>& a, const std::vector<double>& b);
+// Hodges-Lehmann estimate of how much the values in a are above those in b, the median of
+// their pairwise differences
+double shiftEstimate(const std::vector<double>& a, const std::vector<double>& b);
+
+// receives the results while the tree is evaluated, in declaration order also
+// when the examples are evaluated concurrently
+class Reporter {
+    public:
+        virtual ~Reporter();
+        virtual void beginRun() {}
+        virtual void beginGroup(const ExampleGroup* group) {}
+        virtual void beginExample(const Example* example) {}
+        virtual void endExample(const Example* example) {}
+        // hook is "beforeAll" or "afterAll", failures in beforeEach/afterEach fail the example
+        virtual void hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) {}
+        virtual void endGroup(const ExampleGroup* group) {}
+        virtual void endRun(const Statistics& statistics) {}
+};
+
+// the coloured tree
+class ConsoleReporter : public Reporter {
+    public:
+        void beginRun() override;
+        void beginGroup(const ExampleGroup* group) override;
+        void endExample(const Example* example) override;
+        void hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) override;
+        void endGroup(const ExampleGroup* group) override;
+        void endRun(const Statistics& statistics) override;
+
+    private:
+        std::string indent;
+        std::vector<std::string> failures;
+};
+
+// collects the output in a large buffer and writes it with few system calls
+class BufferedWriter {
+    public:
+        explicit BufferedWriter(int fd, bool owned = false) : fd(fd), owned(owned) { buffer.reserve(capacity); }
+        ~BufferedWriter();
+        // "-" is stdout, "&<n>" file descriptor n and everything else a file to be created, null on error
+        static std::unique_ptr<BufferedWriter> open(std::string_view destination);
+        BufferedWriter& operator<<(std::string_view data);
+        void flush();
+
+    private:
+        static constexpr size_t capacity = 64 * 1024;
+        int fd;
+        bool owned;
+        std::string buffer;
+};
+
+// passes the events on to several reporters
+class Reporters : public Reporter {
+    public:
+        void add(std::unique_ptr<Reporter> reporter) { reporters.push_back(std::move(reporter)); }
+        void beginRun() override;
+        void beginGroup(const ExampleGroup* group) override;
+        void beginExample(const Example* example) override;
+        void endExample(const Example* example) override;
+        void hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) override;
+        void endGroup(const ExampleGroup* group) override;
+        void endRun(const Statistics& statistics) override;
+
+    private:
+        std::vector<std::unique_ptr<Reporter>> reporters;
+};
+
+// JUnit XML, one <testsuite> for each group with examples
+class JUnitReporter : public Reporter {
+    public:
+        explicit JUnitReporter(std::unique_ptr<BufferedWriter> out) : out(std::move(out)) {}
+        void beginRun() override;
+        void beginGroup(const ExampleGroup* group) override;
+        void endExample(const Example* example) override;
+        void hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) override;
+        void endGroup(const ExampleGroup* group) override;
+        void endRun(const Statistics& statistics) override;
+
+    private:
+        struct Suite {
+                std::string testcases;
+                unsigned tests = 0, failures = 0, skipped = 0;
+                std::chrono::nanoseconds duration = std::chrono::nanoseconds::zero();
+        };
+        std::unique_ptr<BufferedWriter> out;
+        std::vector<Suite> suites;  // the enclosing groups
+};
+
+// one JSON object per line and event
+class JsonLinesReporter : public Reporter {
+    public:
+        explicit JsonLinesReporter(std::unique_ptr<BufferedWriter> out) : out(std::move(out)) {}
+        void beginGroup(const ExampleGroup* group) override;
+        void endExample(const Example* example) override;
+        void hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) override;
+        void endGroup(const ExampleGroup* group) override;
+        void endRun(const Statistics& statistics) override;
+
+    private:
+        std::unique_ptr<BufferedWriter> out;
+};
+
+// Test Anything Protocol version 13, the plan is printed at the end
+class TapReporter : public Reporter {
+    public:
+        explicit TapReporter(std::unique_ptr<BufferedWriter> out) : out(std::move(out)) {}
+        void beginRun() override;
+        void endExample(const Example* example) override;
+        void hookFailed(const ExampleGroup* group, const char* hook, const assertion_error& error) override;
+        void endRun(const Statistics& statistics) override;
+
+    private:
+        std::unique_ptr<BufferedWriter> out;
+        unsigned count = 0;
+};
+
+// the examples which used the most of a metric, printed at the end of the run
+class TopReporter : public Reporter {
+    public:
+        // metric is one of metrics
+        TopReporter(std::string_view metric, unsigned count, std::unique_ptr<BufferedWriter> out) : metric(metric), count(count), out(std::move(out)) {}
+        void endExample(const Example* example) override;
+        void endRun(const Statistics& statistics) override;
+        static constexpr std::string_view metrics[] = {"duration", "cpu",    "rss",          "faults",       "switches",
+                                                       "instructions", "cycles", "cache-misses", "branch-misses"};
+
+    private:
+        std::string metric;
+        unsigned count;
+        std::unique_ptr<BufferedWriter> out;
+        std::vector<std::pair<double, std::string>> examples;  // value and path
+};
+
+// create the reporter for "<name>[:<destination>]", null and a message on stderr on error
+std::unique_ptr<Reporter> createReporter(std::string_view spec);
+// --top is printed after the console's summary, else on stderr to keep stdout machine readable
+std::string_view topDestination(const std::vector<std::string>& reporters);
+std::string escapeXml(std::string_view text);
+// escapeXml() with tab, newline and carriage return as references, which attribute values would
+// otherwise normalize to spaces
+std::string escapeXmlAttribute(std::string_view text);
+std::string escapeJson(std::string_view text);
+
 struct Item {
         Item(ExampleGroup *parent, const std::string name, std::function<void()> body) : parent(parent), name(name), body(body) {}
         virtual ~Item();
 
         virtual void scan() = 0;
-        virtual void evaluate(Statistics* statistics) = 0;
-        virtual void report(const std::string& indent) = 0;
-        virtual void reportFailures(const std::string& path) = 0;
+        // evaluate and pass the results on to the sequencer
+        virtual void evaluate(Statistics* statistics, Sequencer* sequencer) = 0;
+        // evaluate on the pool and call done() once finished
+        virtual void schedule(ThreadPool* pool, Sequencer* sequencer, std::function<void()> done) = 0;
+        // the names of the groups and the item, separated by " > "
+        std::string path() const;
 
         ExampleGroup *parent;
         std::string name;
@@ -412,6 +1564,12 @@ struct Item {
         bool m_has_focus_child = false;
         bool m_skip = false;
         bool m_has_skip_parent = false;
+        bool m_filtered = false;  // not to be evaluated in this run, e.g. because it's in another shard
+        std::optional<std::chrono::nanoseconds> m_timeout;  // inherited from the parent when not set, 0 disables it
+        uint64_t m_id = 0;        // hash of the path, stable between runs
+        double m_expected = 0;    // expected duration in nanoseconds, 0 when unknown
+        std::atomic<bool> m_started = false;   // a group's beforeAll() ran
+        std::atomic<bool> m_finished = false;  // an example's result or a group's afterAll() is known
 };
 
 struct Example : Item {
@@ -424,16 +1582,57 @@ struct Example : Item {
             m_skip = true;
             return *this;
         }
+        Example& timeout(std::chrono::nanoseconds timeout) {
+            m_timeout = timeout;
+            return *this;
+        }
+        // the number of cases of a property()
+        Example& cases(unsigned cases) {
+            m_cases = cases;
+            return *this;
+        }
+        // evaluate the cases of a property() on this many threads, 0 for all cores
+        Example& parallel(unsigned threads = 0) {
+            m_threads = threads;
+            return *this;
+        }
         // protected:
         void scan() override;
-        void evaluate(Statistics* statistics) override;
-        void report(const std::string& indent) override;
-        void reportFailures(const std::string& path) override;
+        void evaluate(Statistics* statistics, Sequencer* sequencer) override;
+        void schedule(ThreadPool* pool, Sequencer* sequencer, std::function<void()> done) override;
+        // run beforeEach, body and afterEach and remember the result
+        void execute();
+        // call the body in samples of auto-calibrated iterations, see bench()
+        void measure();
+        // fail when the benchmark is significantly slower than the baseline
+        void compareWithBaseline();
+        // evaluate the cases of the property and fail with the shrunk first failing case, see property()
+        void check();
+        // add the result to the statistics
+        void record(Statistics* statistics) const;
 
         bool passed = true;
         bool skipped = false;
-        std::chrono::nanoseconds duration;
+        std::chrono::nanoseconds duration = 0ns;
+        Resources resources;
+        Counters counters;
+        bool m_counters = false;  // take the counters
+        Timing history;
         assertion_error error;
+        bool m_bench = false;
+        Benchmark benchmark;
+        // samples of a previous run the benchmark fails to be significantly slower than
+        std::vector<double> baseline;
+        double m_significance = 0.01;
+        double m_threshold = 0.05;
+        SnapshotStore* m_snapshots = nullptr;
+        unsigned snapshots = 0;  // matched by the last evaluation
+        // generates the values of a case from the choices, describes them when the string isn't null
+        // and calls the body of the property() with them
+        std::function<void(Choices&, std::string*)> m_property;
+        std::optional<unsigned> m_cases;  // taken from the options when not set
+        unsigned m_threads = 1;
+        uint64_t m_seed = 0;
     protected:
         static void evaluateBeforeEach(ExampleGroup *group);
         static void evaluateAfterEach(ExampleGroup *group);
@@ -449,16 +1648,30 @@ struct ExampleGroup : Item {
             m_skip = true;
             return *this;
         }
+        ExampleGroup& timeout(std::chrono::nanoseconds timeout) {
+            m_timeout = timeout;
+            return *this;
+        }
+        // with --jobs, evaluate the items below the group one after another in declaration order
+        ExampleGroup& serial() {
+            m_serial = true;
+            return *this;
+        }
         // protected
         void scan() override;
-        void evaluate(Statistics* statistics) override;
-        void report(const std::string& indent) override;
-        void reportFailures(const std::string& path) override;
+        void evaluate(Statistics* statistics, Sequencer* sequencer) override;
+        void schedule(ThreadPool* pool, Sequencer* sequencer, std::function<void()> done) override;
+        bool focused(const Item* item) const;
+        bool selected(const Item* item) const;
         std::vector<std::unique_ptr<Item>> items;
         std::vector<std::function<void()>> beforeAll;
         std::vector<std::function<void()>> beforeEach;
         std::vector<std::function<void()>> afterEach;
         std::vector<std::function<void()>> afterAll;
+        std::vector<std::vector<std::string>> m_paths;  // set on the root: the bodies of groups not on one of these paths are not executed
+        std::atomic<size_t> pending = 0;  // children not yet finished when scheduled on a pool
+        bool m_serial = false;            // inherited by the groups below
+        std::optional<assertion_error> beforeAllError, afterAllError;
 };
 
 using spec_registry = std::vector<std::function<void()>>;
@@ -472,7 +1685,19 @@ struct spec_registrar {
         spec_registrar(std::function<void()> func) { kaffeeklatsch::detail::specs().push_back(func); }
 };
 
+// scan and evaluate the tree below root, passing the results to options.reporter
+void evaluate(ExampleGroup* root, Statistics* statistics, const Options& options, const TimingDatabase* timings = nullptr);
+void evaluateIsolated(ExampleGroup* root, Statistics* statistics, Sequencer* sequencer, unsigned jobs);
+// filter all examples for which keep() returns false
+void filter(ExampleGroup* root, std::function<bool(const Example*)> keep);
+// split "group > group > example" into it's names
+std::vector<std::string> splitPath(std::string_view path);
+// filter all examples not within the shard-th of shards parts balanced by their expected cost
+void shard(ExampleGroup* root, unsigned shard, unsigned shards, std::function<double(const Example*)> cost);
+
 void tmp_spec(std::function<void()> body, std::function<void(const Statistics&)> eval);
+void tmp_spec(const Options& options, std::function<void()> body, std::function<void(const Statistics&)> eval);
+void tmp_spec(const Options& options, std::function<void()> body, std::function<void(const Statistics&, ExampleGroup* root)> eval);
 
 };  // namespace detail
 
@@ -487,11 +1712,186 @@ detail::Example& it(const std::string& testname, std::function<void()> body);
 detail::Example& fit(const std::string& testname, std::function<void()> body);
 detail::Example& xit(const std::string& testname, std::function<void()> body);
 detail::Example& it(const std::string& testname);
+// an example whose body is a single operation to be measured: it's called in samples
+// of an automatically calibrated number of iterations after a warmup
+detail::Example& bench(const std::string& benchname, std::function<void()> body);
+detail::Example& fbench(const std::string& benchname, std::function<void()> body);
+detail::Example& xbench(const std::string& benchname, std::function<void()> body);
+
+// keep the compiler from optimizing away the computation of value in a bench()
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+template <typename T>
+inline void doNotOptimize(T& value) {
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+// force pending writes to memory to happen in a bench()
+inline void clobberMemory() { asm volatile("" : : : "memory"); }
+// which counters countEvents() needs, hardware includes the software ones
+enum class Events { hardware, software };
+// the perf_event_open() counters of the calling thread while calling fn, e.g. for
+// expect(countEvents(parse).instructions / size).to.be.below(40). throws when the
+// counters aren't available instead of counting 0
+detail::Counters countEvents(const std::function<void()>& fn, Events events = Events::hardware,
+                             std::source_location location = std::source_location::current());
 void beforeEach(std::function<void()> body);
 void afterEach(std::function<void()> body);
 void beforeAll(std::function<void()> body);
 void afterAll(std::function<void()> body);
 
+// generators for property(), they draw their values from the choices so that shrinking the
+// choices shrinks the values, of the generators they are composed of too
+namespace gen {
+
+template <typename T>
+class Generator {
+    public:
+        using value_type = T;
+        explicit Generator(std::function<T(detail::Choices&)> draw) : m_draw(std::move(draw)) {}
+        T operator()(detail::Choices& choices) const { return m_draw(choices); }
+        // fn(value) of the values
+        template <typename F>
+        Generator<std::invoke_result_t<F, T>> map(F fn) const {
+            return Generator<std::invoke_result_t<F, T>>([draw = m_draw, fn](detail::Choices& choices) { return fn(draw(choices)); });
+        }
+        // the values predicate(value) holds for, the case is discarded when it rejects 100 in a row
+        Generator filter(std::function<bool(const T&)> predicate) const {
+            return Generator([draw = m_draw, predicate](detail::Choices& choices) {
+                for (unsigned i = 0; i < 100; ++i) {
+                    auto value = draw(choices);
+                    if (predicate(value)) {
+                        return value;
+                    }
+                }
+                throw detail::Unsatisfiable("gen::filter() rejected 100 values in a row");
+            });
+        }
+
+    private:
+        std::function<T(detail::Choices&)> m_draw;
+};
+
+// integers in min..max, shrinking towards 0 or the bound closest to it
+template <std::integral T = int>
+    requires(!std::same_as<T, bool>)
+Generator<T> integers(T min = std::numeric_limits<T>::min(), T max = std::numeric_limits<T>::max()) {
+    using U = std::make_unsigned_t<T>;
+    return Generator<T>([min, max](detail::Choices& choices) {
+        if (min >= 0) {
+            return static_cast<T>(static_cast<U>(min) + static_cast<U>(choices.draw(static_cast<U>(static_cast<U>(max) - static_cast<U>(min)))));
+        }
+        if (max <= 0) {
+            return static_cast<T>(static_cast<U>(max) - static_cast<U>(choices.draw(static_cast<U>(static_cast<U>(max) - static_cast<U>(min)))));
+        }
+        // the sign first so that a negative value can shrink to it's positive counterpart
+        if (choices.draw(1) == 0) {
+            return static_cast<T>(choices.draw(static_cast<U>(max)));
+        }
+        return static_cast<T>(U(0) - static_cast<U>(choices.draw(static_cast<U>(U(0) - static_cast<U>(min)) - 1) + 1));
+    });
+}
+// false or true, shrinking towards false
+inline Generator<bool> booleans() {
+    return Generator<bool>([](detail::Choices& choices) { return choices.draw(1) != 0; });
+}
+// one of the values, shrinking towards the first
+template <typename T>
+Generator<T> elements(std::vector<T> values) {
+    if (values.empty()) {
+        throw std::invalid_argument("gen::elements() needs at least one value");
+    }
+    return Generator<T>([values = std::move(values)](detail::Choices& choices) { return values[choices.draw(values.size() - 1)]; });
+}
+// always value
+template <typename T>
+Generator<T> just(T value) {
+    return Generator<T>([value = std::move(value)](detail::Choices&) { return value; });
+}
+// the value of one of the generators, shrinking towards the first
+template <typename T, typename... G>
+Generator<T> oneOf(Generator<T> first, G... others) {
+    std::vector<Generator<T>> generators{first, others...};
+    return Generator<T>([generators = std::move(generators)](detail::Choices& choices) { return generators[choices.draw(generators.size() - 1)](choices); });
+}
+// fn(values...) of the values drawn from the generators, e.g. for user types
+template <typename F, typename... G>
+auto map(F fn, G... generators) {
+    using T = std::invoke_result_t<F, typename G::value_type...>;
+    return Generator<T>([fn, generators...](detail::Choices& choices) {
+        // the braces draw in order, the arguments of a call don't
+        std::tuple<typename G::value_type...> values{generators(choices)...};
+        return std::apply(fn, std::move(values));
+    });
+}
+// T{values...} of the values drawn from the generators
+template <typename T, typename... G>
+Generator<T> construct(G... generators) {
+    return map([](auto&&... values) { return T{std::forward<decltype(values)>(values)...}; }, generators...);
+}
+// characters of the alphabet, shrinking towards the first
+inline Generator<char> characters(std::string alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~") {
+    return Generator<char>([alphabet = std::move(alphabet)](detail::Choices& choices) { return alphabet[choices.draw(alphabet.size() - 1)]; });
+}
+// containers like std::vector, std::string or std::set with minSize to maxSize elements drawn from
+// element, the length grows with the cases. shrinking removes elements and shrinks the others
+template <typename C, typename E>
+Generator<C> containers(Generator<E> element, size_t minSize = 0, size_t maxSize = std::numeric_limits<size_t>::max()) {
+    return Generator<C>([element, minSize, maxSize](detail::Choices& choices) {
+        C container;
+        for (size_t size = 0; size < maxSize && (size < minSize || choices.more()); ++size) {
+            container.insert(container.end(), element(choices));
+        }
+        return container;
+    });
+}
+template <typename T>
+Generator<std::vector<T>> vectors(Generator<T> element, size_t minSize = 0, size_t maxSize = std::numeric_limits<size_t>::max()) {
+    return containers<std::vector<T>>(element, minSize, maxSize);
+}
+inline Generator<std::string> strings(Generator<char> character = characters(), size_t minSize = 0, size_t maxSize = std::numeric_limits<size_t>::max()) {
+    return containers<std::string>(character, minSize, maxSize);
+}
+
+}  // namespace gen
+
+namespace detail {
+template <typename Body, typename... G>
+std::function<void(Choices&, std::string*)> propertyCase(Body body, G... generators) {
+    return [body, generators...](Choices& choices, std::string* description) {
+        std::tuple<typename G::value_type...> values{generators(choices)...};
+        if (description) {
+            std::apply([&](const auto&... value) { ((*description += (description->empty() ? "" : ", ") + formatValue(value)), ...); }, values);
+        }
+        std::apply(body, values);
+    };
+}
+template <typename Args, size_t... I>
+std::function<void(Choices&, std::string*)> propertyCase(const Args& args, std::index_sequence<I...>) {
+    return propertyCase(std::get<sizeof...(I)>(args), std::get<I>(args)...);
+}
+}  // namespace detail
+
+// property(<name>, <generator>..., <body>): an example which calls the body with values drawn from
+// the generators in 100 cases (change with .cases(<n>) or --cases=<n>), on several threads with
+// .parallel(<n>), and reports the first failing case shrunk to a minimal counterexample
+template <typename... Args>
+detail::Example& property(const std::string& propertyname, Args... args) {
+    static_assert(sizeof...(Args) >= 1, "property(<name>, <generator>..., <body>)");
+    auto& example = it(propertyname, [] {});
+    example.m_property = detail::propertyCase(std::tuple(args...), std::make_index_sequence<sizeof...(Args) - 1>());
+    return example;
+}
+template <typename... Args>
+detail::Example& fproperty(const std::string& propertyname, Args... args) {
+    return property(propertyname, args...).only();
+}
+template <typename... Args>
+detail::Example& xproperty(const std::string& propertyname, Args... args) {
+    return property(propertyname, args...).skip();
+}
+
 };  // namespace kaffeeklatsch
 
 #define KAFFEEKLATSCH_CONCAT2(a, b) a##b
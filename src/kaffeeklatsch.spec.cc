@@ -1,32 +1,91 @@
 #include "kaffeeklatsch.hh"
 using namespace kaffeeklatsch;
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <thread>
 
 using namespace std;
 
 // TODO
 // [ ] add test for .undefined()
-// [ ] implement timeout & setting timeout
+// [X] implement timeout & setting timeout
 // [ ] run beforeEach & afterEach within Example::evaluate to include errors thrown there into the test's result
 // [ ] add tests for describe()/it() without body
 // [ ] render skipped group in gray, especially when it has no examples
 // [ ] catch and report stdout/stderr
 // [ ] use std::stacktrace once available
 // [ ] many more matchers
-// [ ] eq container, print a diff
-// [ ] almost
+// [X] eq container, print a diff
+// [X] almost
 // [ ] context, subject, shared_context, shared_example and other RSpec stuff (example, specify, focus, ...), feature, scenario
 // [ ] exit with -1 when a least one test fails
 // [ ] command line arguments
-// [ ] disable colors when output is not a tty
-// [ ] execute and print the test report in one go... or run threads...
+// [X] disable colors when output is not a tty
+// [X] execute and print the test report in one go... or run threads...
 // feature and scenario are a part of Capybara, and not RSpec, and are meant to be used for acceptance tests.
 // feature is equivalent to describe / context, and scenario equivalent to it / example.
 // https://rspec.rubystyle.guide
 
 enum MyEnum { M0, M1, M2 };
 
+// examples forking workers take turns when the spec itself is evaluated with --jobs,
+// otherwise the workers of one inherit the pipes of another and it never sees their EOF
+mutex forking;
+
+// evaluate the spec with a reporter writing into a file and return the file's content
+string reportTo(const string &name, function<void()> spec) {
+    auto filename = (filesystem::temp_directory_path() / format("kaffeeklatsch-{}.{}", getpid(), name)).string();
+    {
+        auto reporter = detail::createReporter(format("{}:{}", name, filename));
+        detail::Options options;
+        options.reporter = reporter.get();
+        detail::tmp_spec(options, spec, [](const detail::Statistics &) {});
+    }
+    ifstream in(filename);
+    string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    filesystem::remove(filename);
+    return content;
+}
+
+// counts how often it was copied
+struct Copies {
+        unsigned value = 0;
+        mutable unsigned copies = 0;
+        Copies() = default;
+        Copies(unsigned value) : value(value) {}
+        Copies(const Copies &other) : value(other.value) { ++other.copies; }
+        bool operator==(const Copies &other) const { return value == other.value; }
+};
+
+// a user type for the generators of property()
+struct Point {
+        int x, y;
+};
+ostream &operator<<(ostream &out, const Point &point) { return out << format("({}, {})", point.x, point.y); }
+
+// records the reporter's events
+struct LogReporter : detail::Reporter {
+        vector<string> log;
+        void beginGroup(const detail::ExampleGroup *group) override { log.push_back("begin " + group->name); }
+        void endExample(const detail::Example *example) override { log.push_back(example->name + (example->passed ? "" : " failed")); }
+        void hookFailed(const detail::ExampleGroup *group, const char *hook, const assertion_error &error) override {
+            log.push_back(format("{} {}: {}", group->name, hook, error.what()));
+        }
+        void endGroup(const detail::ExampleGroup *group) override { log.push_back("end " + group->name); }
+        void endRun(const detail::Statistics &statistics) override { log.push_back(format("{} tests", statistics.numTotalTests)); }
+};
+
 kaffeeklatsch_spec([] {
     describe("runner", [] {
         describe("demo", [] {
@@ -34,6 +93,7 @@ kaffeeklatsch_spec([] {
             it("fail", [] { expect(false).to.eq(true); });
             it("slow", [] { usleep(40000); });
             it("very slow", [] { usleep(80000); });
+            bench("bench", [] { doNotOptimize(to_string(42)); });
         });
         describe("examples and groups", [] {
             it("no descriptions, no examples", [] {
@@ -282,9 +342,1168 @@ kaffeeklatsch_spec([] {
                 });
             });
         });
+        describe("parallel: --jobs=<n>", [] {
+            it("evaluates examples concurrently", [] {
+                atomic<unsigned> running = 0, maxRunning = 0;
+                detail::Options options;
+                options.jobs = 4;
+                detail::tmp_spec(
+                    options,
+                    [&] {
+                        for (int i = 0; i < 8; ++i) {
+                            it("example", [&] {
+                                auto n = ++running;
+                                for (auto m = maxRunning.load(); n > m && !maxRunning.compare_exchange_weak(m, n);) {
+                                }
+                                usleep(10000);
+                                --running;
+                            });
+                        }
+                    },
+                    [&](const detail::Statistics &statistics) {
+                        expect(statistics.numTotalTests).to.equal(8);
+                        expect(statistics.numPassedTests).to.equal(8);
+                        expect(maxRunning.load()).to.be.above(1u);
+                    });
+            });
+            it("runs beforeAll() and afterAll() once around their subtree", [] {
+                mutex m;
+                vector<string> log;
+                auto append = [&](const string &entry) {
+                    lock_guard lock(m);
+                    log.push_back(entry);
+                };
+                detail::Options options;
+                options.jobs = 4;
+                detail::tmp_spec(
+                    options,
+                    [&] {
+                        describe("0", [&] {
+                            beforeAll([&] { append("0 beforeAll"); });
+                            afterAll([&] { append("0 afterAll"); });
+                            for (int i = 0; i < 4; ++i) {
+                                it("it", [&] { append("0 it"); });
+                            }
+                            describe("1", [&] {
+                                beforeAll([&] { append("1 beforeAll"); });
+                                afterAll([&] { append("1 afterAll"); });
+                                for (int i = 0; i < 4; ++i) {
+                                    it("it", [&] { append("1 it"); });
+                                }
+                            });
+                        });
+                    },
+                    [&](const detail::Statistics &statistics) {
+                        expect(statistics.numTotalTestSuites).to.equal(2);
+                        expect(statistics.numPassedTests).to.equal(8);
+                        expect(log.size()).to.equal(12u);
+                        expect(log.front()).to.equal("0 beforeAll");
+                        expect(log.back()).to.equal("0 afterAll");
+                        auto first = find(log.begin(), log.end(), "1 beforeAll");
+                        auto last = find(log.begin(), log.end(), "1 afterAll");
+                        expect(count(log.begin(), first, "1 it")).to.equal(0);
+                        expect(count(last, log.end(), "1 it")).to.equal(0);
+                        expect(count(first, last, "1 it")).to.equal(4);
+                    });
+            });
+            it(".serial() evaluates the group's subtree one after another in declaration order", [] {
+                mutex m;
+                vector<string> log;
+                atomic<unsigned> running = 0, maxRunning = 0;
+                auto append = [&](const string &entry) {
+                    auto n = ++running;
+                    for (auto max = maxRunning.load(); n > max && !maxRunning.compare_exchange_weak(max, n);) {
+                    }
+                    {
+                        lock_guard lock(m);
+                        log.push_back(entry);
+                    }
+                    usleep(1000);
+                    --running;
+                };
+                detail::Options options;
+                options.jobs = 4;
+                detail::tmp_spec(
+                    options,
+                    [&] {
+                        describe("serial", [&] {
+                            beforeEach([&] { append("beforeEach"); });
+                            it("0", [&] { append("0"); });
+                            describe("1", [&] {
+                                it("1", [&] { append("1"); });
+                                it("2", [&] { append("2"); });
+                            });
+                            it("3", [&] { append("3"); });
+                        }).serial();
+                    },
+                    [&](const detail::Statistics &statistics) {
+                        expect(statistics.numPassedTests).to.equal(4);
+                        expect(maxRunning.load()).to.equal(1u);
+                        vector<string> e = {"beforeEach", "0", "beforeEach", "1", "beforeEach", "2", "beforeEach", "3"};
+                        expect(log).to.equal(e);
+                    });
+            });
+            it("honours focus", [] {
+                atomic<unsigned> count = 0;
+                detail::Options options;
+                options.jobs = 2;
+                detail::tmp_spec(
+                    options,
+                    [&] {
+                        it("test0", [&] { ++count; });
+                        fit("test1", [&] { ++count; });
+                    },
+                    [&](const detail::Statistics &statistics) {
+                        expect(statistics.numTotalTests).to.equal(1);
+                        expect(count.load()).to.equal(1u);
+                    });
+            });
+        });
+        describe("process isolation: --isolate", [] {
+            it("records a crashing example as failure and continues with a new worker", [] {
+                lock_guard lock(forking);
+                detail::Options options;
+                options.isolate = true;
+                detail::tmp_spec(
+                    options,
+                    [&] {
+                        it("test0", [] {});
+                        it("test1", [] { abort(); });
+                        it("test2", [] {});
+                        it("test3", [] { expect(1).to.equal(2); });
+                        xit("test4", [] {});
+                    },
+                    [&](const detail::Statistics &statistics) {
+                        expect(statistics.numTotalTests).to.equal(5);
+                        expect(statistics.numPassedTests).to.equal(2);
+                        expect(statistics.numFailedTests).to.equal(2);
+                        expect(statistics.numSkippedTests).to.equal(1);
+                    });
+            });
+            it("runs beforeAll() once per worker", [] {
+                lock_guard lock(forking);
+                int fds[2];
+                expect(pipe(fds)).to.equal(0);
+                detail::Options options;
+                options.isolate = true;
+                options.jobs = 2;
+                detail::tmp_spec(
+                    options,
+                    [&] {
+                        describe("group", [&] {
+                            beforeAll([&] { expect(write(fds[1], "b", 1)).to.equal(1); });
+                            afterAll([&] { expect(write(fds[1], "a", 1)).to.equal(1); });
+                            for (int i = 0; i < 6; ++i) {
+                                it("example", [] {});
+                            }
+                        });
+                    },
+                    [&](const detail::Statistics &statistics) {
+                        expect(statistics.numTotalTestSuites).to.equal(1);
+                        expect(statistics.numPassedTests).to.equal(6);
+                    });
+                close(fds[1]);
+                string log;
+                char c;
+                while (read(fds[0], &c, 1) == 1) {
+                    log += c;
+                }
+                close(fds[0]);
+                expect(log.size()).to.equal(4u);
+                expect(ranges::count(log, 'b')).to.equal(2);
+                expect(ranges::count(log, 'a')).to.equal(2);
+            });
+        });
+        describe("sharding: --shard=<i>/<n>", [] {
+            it("splits the examples into disjoint shards of about the same size", [] {
+                vector<string> log;
+                auto spec = [&] {
+                    describe("group0", [&] {
+                        for (int i = 0; i < 5; ++i) {
+                            it(to_string(i), [&, i] { log.push_back(format("0.{}", i)); });
+                        }
+                    });
+                    describe("group1", [&] {
+                        for (int i = 0; i < 4; ++i) {
+                            it(to_string(i), [&, i] { log.push_back(format("1.{}", i)); });
+                        }
+                    });
+                };
+                vector<unsigned> sizes;
+                for (unsigned shard = 1; shard <= 3; ++shard) {
+                    detail::Options options;
+                    options.shard = shard;
+                    options.shards = 3;
+                    detail::tmp_spec(options, spec, [&](const detail::Statistics &statistics) { sizes.push_back(statistics.numTotalTests); });
+                }
+                expect(sizes).to.equal(vector{3u, 3u, 3u});
+                sort(log.begin(), log.end());
+                expect(log.size()).to.equal(9u);
+                expect(unique(log.begin(), log.end()) == log.end()).to.beTrue();
+            });
+            it("keeps groups with beforeAll() or afterAll() on one shard", [] {
+                vector<string> log;
+                auto spec = [&] {
+                    describe("fixture", [&] {
+                        beforeAll([&] { log.push_back("beforeAll"); });
+                        for (int i = 0; i < 4; ++i) {
+                            it(to_string(i), [&] { log.push_back("fixture"); });
+                        }
+                    });
+                    for (int i = 0; i < 4; ++i) {
+                        it(to_string(i), [&] { log.push_back("it"); });
+                    }
+                };
+                vector<vector<string>> logs;
+                vector<unsigned> suites;
+                for (unsigned shard = 1; shard <= 2; ++shard) {
+                    detail::Options options;
+                    options.shard = shard;
+                    options.shards = 2;
+                    log.clear();
+                    detail::tmp_spec(options, spec, [&](const detail::Statistics &statistics) { suites.push_back(statistics.numTotalTestSuites); });
+                    logs.push_back(log);
+                }
+                expect(suites).to.equal(vector{1u, 0u});
+                expect(logs[0]).to.equal(vector<string>{"beforeAll", "fixture", "fixture", "fixture", "fixture"});
+                expect(logs[1]).to.equal(vector<string>{"it", "it", "it", "it"});
+            });
+            it("splits below the root and runs the root's beforeAll() and afterAll() on every shard", [] {
+                vector<string> log;
+                auto spec = [&] {
+                    beforeAll([&] { log.push_back("beforeAll"); });
+                    afterAll([&] { log.push_back("afterAll"); });
+                    for (int i = 0; i < 4; ++i) {
+                        it(to_string(i), [&, i] { log.push_back(to_string(i)); });
+                    }
+                };
+                vector<vector<string>> logs;
+                for (unsigned shard = 1; shard <= 2; ++shard) {
+                    detail::Options options;
+                    options.shard = shard;
+                    options.shards = 2;
+                    log.clear();
+                    detail::tmp_spec(options, spec, [&](const detail::Statistics &statistics) { expect(statistics.numTotalTests).to.equal(2); });
+                    logs.push_back(log);
+                }
+                expect(logs[0]).to.equal(vector<string>{"beforeAll", "0", "2", "afterAll"});
+                expect(logs[1]).to.equal(vector<string>{"beforeAll", "1", "3", "afterAll"});
+            });
+        });
+        describe("rerun failures: --only-failures, --next-failure", [] {
+            auto spec = [](vector<string> *log) {
+                return [log] {
+                    describe("group0", [log] {
+                        it("test0.0", [log] { log->push_back("0.0"); });
+                        it("test0.1", [log] {
+                            log->push_back("0.1");
+                            expect(1).to.equal(2);
+                        });
+                    });
+                    describe("group1", [log] {
+                        beforeAll([log] { log->push_back("1 beforeAll"); });
+                        it("test1.0", [log] {
+                            log->push_back("1.0");
+                            expect(1).to.equal(2);
+                        });
+                        it("test1.1", [log] { log->push_back("1.1"); });
+                    });
+                };
+            };
+            it("evaluates only the failed examples and the hooks they need", [=] {
+                vector<string> log;
+                detail::StatusDatabase status;
+                detail::tmp_spec(detail::Options(), spec(&log), [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                    expect(statistics.numFailedTests).to.equal(2);
+                    status.update(root);
+                });
+                expect(status.failures().size()).to.equal(2u);
+
+                log.clear();
+                detail::Options options;
+                options.only = status.failures();
+                detail::tmp_spec(options, spec(&log), [&](const detail::Statistics &statistics) {
+                    expect(statistics.numTotalTests).to.equal(2);
+                    expect(statistics.numTotalTestSuites).to.equal(2);
+                });
+                expect(log).to.equal(vector<string>{"0.1", "1 beforeAll", "1.0"});
+
+                log.clear();
+                options.onlyFirst = true;
+                detail::tmp_spec(options, spec(&log), [&](const detail::Statistics &statistics) {
+                    expect(statistics.numTotalTests).to.equal(1);
+                    expect(statistics.numTotalTestSuites).to.equal(1);
+                });
+                expect(log).to.equal(vector<string>{"0.1"});
+            });
+            it("save() and load() the status", [=] {
+                auto filename = (filesystem::temp_directory_path() / format("kaffeeklatsch-{}.status", getpid())).string();
+                vector<string> log;
+                detail::StatusDatabase out;
+                detail::tmp_spec(detail::Options(), spec(&log), [&](const detail::Statistics &, detail::ExampleGroup *root) { out.update(root); });
+                expect(out.save(filename)).to.beTrue();
+                expect(filesystem::exists(filename + ".tmp")).to.beFalse();
+                detail::StatusDatabase in;
+                expect(in.load(filename)).to.beTrue();
+                filesystem::remove(filename);
+                expect(in.failures() == out.failures()).to.beTrue();
+            });
+        });
+        describe("filter: --path=<path>, --grep=<regex>", [] {
+            auto spec = [](vector<string> *log) {
+                return [log] {
+                    describe("group0", [log] {
+                        log->push_back("group0");
+                        it("test0.0", [log] { log->push_back("0.0"); });
+                    });
+                    describe("group1", [log] {
+                        log->push_back("group1");
+                        it("test1.0", [log] { log->push_back("1.0"); });
+                        describe("group1.1", [log] {
+                            log->push_back("group1.1");
+                            it("test1.1.0", [log] { log->push_back("1.1.0"); });
+                            it("test1.1.1", [log] { log->push_back("1.1.1"); });
+                        });
+                    });
+                };
+            };
+            it("--path does not execute the bodies of groups outside of the path", [=] {
+                vector<string> log;
+                detail::Options options;
+                options.paths.push_back("group1 > group1.1");
+                detail::tmp_spec(options, spec(&log), [&](const detail::Statistics &statistics) {
+                    expect(statistics.numTotalTests).to.equal(2);
+                    expect(statistics.numTotalTestSuites).to.equal(2);
+                });
+                expect(log).to.equal(vector<string>{"group1", "group1.1", "1.1.0", "1.1.1"});
+            });
+            it("--path can select a single example", [=] {
+                vector<string> log;
+                detail::Options options;
+                options.paths.push_back("group1 > group1.1 > test1.1.1");
+                detail::tmp_spec(options, spec(&log), [&](const detail::Statistics &statistics) { expect(statistics.numTotalTests).to.equal(1); });
+                expect(log).to.equal(vector<string>{"group1", "group1.1", "1.1.1"});
+            });
+            it("--grep selects examples by their path", [=] {
+                vector<string> log;
+                detail::Options options;
+                options.grep = "\\.0$";
+                detail::tmp_spec(options, spec(&log), [&](const detail::Statistics &statistics) { expect(statistics.numTotalTests).to.equal(3); });
+                expect(log).to.equal(vector<string>{"group0", "group1", "group1.1", "0.0", "1.0", "1.1.0"});
+            });
+        });
+        describe("timeout: .timeout(<duration>), --timeout=<ms>", [] {
+            auto exampleAt = [](detail::ExampleGroup *group, size_t index) { return dynamic_cast<detail::Example *>(group->items[index].get()); };
+            it("fails an example which exceeds it's timeout", [=] {
+                detail::tmp_spec(
+                    detail::Options(),
+                    [] {
+                        it("slow", [] { this_thread::sleep_for(50ms); }).timeout(20ms);
+                        it("fast", [] {}).timeout(20ms);
+                    },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numFailedTests).to.equal(1);
+                        expect(statistics.numPassedTests).to.equal(1);
+                        expect(string(exampleAt(root, 0)->error.what())).to.equal("timeout of 20ms exceeded");
+                    });
+            });
+            it("inherits the timeout from the enclosing group and the options", [=] {
+                detail::Options options;
+                options.timeout = 20ms;
+                detail::tmp_spec(
+                    options,
+                    [] {
+                        describe("group", [] { it("slow", [] { this_thread::sleep_for(50ms); }); }).timeout(100ms);
+                        it("slow", [] { this_thread::sleep_for(50ms); });
+                    },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numFailedTests).to.equal(1);
+                        expect(exampleAt(root, 1)->passed).to.beFalse();
+                    });
+            });
+            it("defaults to 60s", [=] {
+                detail::tmp_spec(
+                    detail::Options(), [] { it("slow", [] { this_thread::sleep_for(30ms); }); },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numPassedTests).to.equal(1);
+                        expect(exampleAt(root, 0)->m_timeout.value_or(0ns) == 60s).to.beTrue();
+                    });
+            });
+            it("0 disables the timeout", [=] {
+                detail::Options options;
+                options.timeout = 0ms;
+                detail::tmp_spec(
+                    options, [] { it("slow", [] { this_thread::sleep_for(30ms); }); },
+                    [&](const detail::Statistics &statistics) { expect(statistics.numPassedTests).to.equal(1); });
+            });
+            it("--grace=<ms> ends the run with a backtrace when an example doesn't return", [=] {
+                lock_guard lock(forking);
+                int fds[2];
+                expect(pipe(fds)).to.equal(0);
+                auto pid = fork();
+                if (pid == 0) {
+                    close(fds[0]);
+                    dup2(fds[1], STDERR_FILENO);
+                    int null = open("/dev/null", O_WRONLY);
+                    dup2(null, STDOUT_FILENO);
+                    detail::specs() = {[] {
+                        it("stuck", [] {
+                            for (;;) {
+                                pause();
+                            }
+                        });
+                    }};
+                    const char *argv[] = {"tests", "--timeout=20", "--grace=50"};
+                    run(3, const_cast<char **>(argv));
+                    _exit(0);
+                }
+                close(fds[1]);
+                string output;
+                char buffer[4096];
+                for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;) {
+                    output.append(buffer, n);
+                }
+                close(fds[0]);
+                int status = 0;
+                waitpid(pid, &status, 0);
+                expect(WIFEXITED(status) && WEXITSTATUS(status) == 1).to.beTrue();
+                auto ending = string("kaffeeklatsch: 'stuck' didn't return within 50ms after it's timeout, ending the run\n");
+                expect(output.starts_with("kaffeeklatsch: 'stuck' exceeded it's timeout of 20ms\n" + ending)).to.beTrue();
+                expect(output.size()).to.be.above(ending.size() + 60);  // the backtrace
+            });
+            it("--isolate kills a stuck example and continues with a new worker", [=] {
+                lock_guard lock(forking);
+                detail::Options options;
+                options.isolate = true;
+                detail::tmp_spec(
+                    options,
+                    [] {
+                        it("stuck", [] {
+                            for (;;) {
+                                pause();
+                            }
+                        }).timeout(100ms);
+                        it("next", [] {});
+                    },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numFailedTests).to.equal(1);
+                        expect(statistics.numPassedTests).to.equal(1);
+                        expect(string(exampleAt(root, 0)->error.what()).starts_with("timeout of 100ms exceeded, worker killed")).to.beTrue();
+                    });
+            });
+            it("--isolate kills a stuck example while the other workers keep sending results", [=] {
+                lock_guard lock(forking);
+                detail::Options options;
+                options.isolate = true;
+                options.jobs = 2;
+                detail::tmp_spec(
+                    options,
+                    [] {
+                        it("stuck", [] {
+                            for (;;) {
+                                pause();
+                            }
+                        }).timeout(100ms);
+                        for (unsigned i = 0; i < 500; ++i) {
+                            it(format("busy {}", i), [] { this_thread::sleep_for(2ms); });
+                        }
+                    },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numFailedTests).to.equal(1);
+                        expect(statistics.numPassedTests).to.equal(500);
+                        expect(exampleAt(root, 0)->duration).to.be.below(600ms);
+                    });
+            });
+        });
+        describe("reporter", [] {
+            auto spec = [] {
+                describe("group0", [] {
+                    it("test0.0", [] { this_thread::sleep_for(20ms); });
+                    it("test0.1", [] {});
+                });
+                describe("group1", [] {
+                    it("test1.0", [] { this_thread::sleep_for(10ms); });
+                    it("test1.1", [] { expect(1).to.equal(2); });
+                });
+            };
+            vector<string> expected{"begin ",  "begin group0", "test0.0", "test0.1",        "end group0", "begin group1",
+                                    "test1.0", "test1.1 failed", "end group1", "end ", "4 tests"};
+            for (auto [isolate, jobs] : {pair{false, 1u}, pair{false, 4u}, pair{true, 4u}}) {
+                it(format("receives the results in declaration order with{} --jobs={}", isolate ? " --isolate" : "", jobs), [=] {
+                    unique_lock lock(forking, defer_lock);
+                    if (isolate) {
+                        lock.lock();
+                    }
+                    LogReporter reporter;
+                    detail::Options options;
+                    options.isolate = isolate;
+                    options.jobs = jobs;
+                    options.reporter = &reporter;
+                    detail::tmp_spec(options, spec, [](const detail::Statistics &) {});
+                    expect(reporter.log).to.equal(expected);
+                });
+            }
+            it("receives failed hooks and fails the examples below a failed beforeAll()", [] {
+                LogReporter reporter;
+                detail::Options options;
+                options.reporter = &reporter;
+                detail::tmp_spec(
+                    options,
+                    [] {
+                        describe("group0", [] {
+                            beforeAll([] { throw runtime_error("oops"); });
+                            it("test0.0", [] {});
+                        });
+                        describe("group1", [] {
+                            afterAll([] { throw runtime_error("oops"); });
+                            it("test1.0", [] {});
+                        });
+                    },
+                    [](const detail::Statistics &statistics) {
+                        expect(statistics.numFailedTests).to.equal(1);
+                        expect(statistics.numPassedTests).to.equal(1);
+                    });
+                expect(reporter.log).to.equal(vector<string>{"begin ", "begin group0", "group0 beforeAll: oops", "test0.0 failed", "end group0",
+                                                             "begin group1", "test1.0", "group1 afterAll: oops", "end group1", "end ", "2 tests"});
+            });
+            describe("--reporter=junit|jsonl|tap", [] {
+                auto spec = [] {
+                    describe("group", [] {
+                        it("passes", [] {});
+                        it("fails <&>", [] { expect(1).to.equal(2); });
+                        xit("skipped", [] {});
+                    });
+                };
+                it("junit", [=] {
+                    auto xml = reportTo("junit", spec);
+                    expect(xml.starts_with("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n")).to.beTrue();
+                    expect(xml.find("<testsuite name=\"group\" tests=\"3\" failures=\"1\" errors=\"0\" skipped=\"1\"")).to.not_().equal(string::npos);
+                    expect(xml.find("<testcase classname=\"group\" name=\"fails &lt;&amp;&gt;\"")).to.not_().equal(string::npos);
+                    expect(xml.find("\">kaffeeklatsch.spec.cc:")).to.not_().equal(string::npos);
+                    expect(xml.find(": expected 1 to equal 2</failure>")).to.not_().equal(string::npos);
+                    expect(xml.ends_with("</testsuites>\n")).to.beTrue();
+                    auto lines = reportTo("junit", [] { it("fails", [] { expect(string("a\nb")).to.equal(string("a\nc")); }); });
+                    expect(lines.find("message=\"expected &quot;a&#10;b&quot; to equal &quot;a&#10;c&quot;\"")).to.not_().equal(string::npos);
+                    expect(lines.find(": expected &quot;a\nb&quot; to equal &quot;a\nc&quot;</failure>")).to.not_().equal(string::npos);
+                });
+                it("jsonl", [=] {
+                    auto json = reportTo("jsonl", spec);
+                    expect(ranges::count(json, '\n')).to.equal(8);
+                    expect(json.find("{\"event\":\"example\",\"path\":\"group > skipped\",\"status\":\"skipped\"")).to.not_().equal(string::npos);
+                    expect(json.find("\"message\":\"expected 1 to equal 2\"}")).to.not_().equal(string::npos);
+                    expect(json.find(",\"resources\":{\"user\":")).to.not_().equal(string::npos);
+                    expect(json.find("{\"event\":\"summary\",\"tests\":3,\"passed\":1,\"failed\":1,\"skipped\":1,\"suites\":1,")).to.not_().equal(string::npos);
+                });
+                it("tap", [=] {
+                    auto tap = reportTo("tap", spec);
+                    expect(tap.starts_with("TAP version 13\nok 1 - group > passes # time=")).to.beTrue();
+                    expect(tap.find("\nnot ok 2 - group > fails <&> # time=")).to.not_().equal(string::npos);
+                    expect(tap.find("  ---\n  message: \"expected 1 to equal 2\"\n")).to.not_().equal(string::npos);
+                    expect(tap.ends_with("\nok 3 - group > skipped # SKIP\n1..3\n")).to.beTrue();
+                });
+            });
+            it("releases the bodies of reported examples", [] {
+                weak_ptr<int> captured;
+                detail::tmp_spec(
+                    detail::Options(),
+                    [&] {
+                        auto data = make_shared<int>(0);
+                        captured = data;
+                        it("test", [data] { ++*data; });
+                    },
+                    [&](const detail::Statistics &statistics) {
+                        expect(statistics.numPassedTests).to.equal(1);
+                        expect(captured.expired()).to.beTrue();
+                    });
+            });
+        });
+        describe("trace: --trace=<file>", [] {
+            auto trace = [](bool isolate) {
+                unique_lock lock(forking, defer_lock);
+                if (isolate) {
+                    lock.lock();
+                }
+                auto filename = (filesystem::temp_directory_path() / format("kaffeeklatsch-{}-{}.trace", getpid(), isolate)).string();
+                detail::Options options;
+                options.trace = filename;
+                options.isolate = isolate;
+                detail::tmp_spec(
+                    options,
+                    [] {
+                        describe("group", [] {
+                            beforeAll([] {});
+                            beforeEach([] {});
+                            afterEach([] {});
+                            afterAll([] {});
+                            it("example", [] {});
+                        });
+                    },
+                    [](const detail::Statistics &statistics) { expect(statistics.numPassedTests).to.equal(1); });
+                ifstream in(filename);
+                string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+                filesystem::remove(filename);
+                return content;
+            };
+            for (auto isolate : {false, true}) {
+                it(format("records examples, hooks and groups{}", isolate ? " in forked workers" : ""), [=] {
+                    auto json = trace(isolate);
+                    expect(json.starts_with("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n")).to.beTrue();
+                    for (auto hook : {"beforeAll", "beforeEach", "afterEach", "afterAll"}) {
+                        expect(json.find(format("{{\"name\":\"{}\",\"cat\":\"hook\",\"ph\":\"X\"", hook))).to.not_().equal(string::npos);
+                    }
+                    expect(json.find("{\"name\":\"example\",\"cat\":\"example\",\"ph\":\"X\"")).to.not_().equal(string::npos);
+                    expect(json.find("\"args\":{\"path\":\"group > example\"}")).to.not_().equal(string::npos);
+                    expect(json.find("{\"name\":\"group\",\"cat\":\"group\",\"ph\":\"b\"")).to.not_().equal(string::npos);
+                    expect(json.find("{\"name\":\"group\",\"cat\":\"group\",\"ph\":\"e\"")).to.not_().equal(string::npos);
+                    expect(json.find("\"args\":{\"name\":\"worker ") != string::npos).to.equal(isolate);
+                    expect(json.ends_with("]}\n")).to.beTrue();
+                });
+            }
+        });
+        describe("bench(<name>, <body>)", [] {
+            auto exampleAt = [](detail::ExampleGroup *group, size_t index) { return dynamic_cast<detail::Example *>(group->items[index].get()); };
+            it("calls the body in calibrated samples", [=] {
+                unsigned calls = 0;
+                detail::tmp_spec(
+                    detail::Options(),
+                    [&] {
+                        bench("increment", [&] {
+                            ++calls;
+                            doNotOptimize(calls);
+                        });
+                    },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numPassedTests).to.equal(1);
+                        auto &benchmark = exampleAt(root, 0)->benchmark;
+                        expect(benchmark.samples).to.equal(10u);
+                        expect(benchmark.iterations).to.be.above(1000u);
+                        expect(calls).to.be.above(benchmark.samples * benchmark.iterations);
+                        expect(benchmark.min <= benchmark.median && benchmark.median <= benchmark.mean + 3 * benchmark.stddev).to.beTrue();
+                    });
+            });
+            it("runs beforeEach() and afterEach() once around the samples", [=] {
+                unsigned before = 0, after = 0;
+                detail::tmp_spec(
+                    detail::Options(),
+                    [&] {
+                        beforeEach([&] { ++before; });
+                        afterEach([&] { ++after; });
+                        bench("nothing", [] { clobberMemory(); });
+                    },
+                    [&](const detail::Statistics &) {});
+                expect(before).to.equal(1u);
+                expect(after).to.equal(1u);
+            });
+            it("xbench() skips and fbench() focuses", [=] {
+                detail::tmp_spec(
+                    detail::Options(),
+                    [] {
+                        xbench("skipped", [] {});
+                        fbench("focused", [] {});
+                        bench("other", [] {});
+                    },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numTotalTests).to.equal(1);
+                        expect(exampleAt(root, 1)->benchmark.samples).to.equal(10u);
+                        expect(exampleAt(root, 2)->benchmark.samples).to.equal(0u);
+                    });
+            });
+            it("fails when the body throws", [=] {
+                detail::tmp_spec(
+                    detail::Options(), [] { bench("throws", [] { expect(1).to.equal(2); }); },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numFailedTests).to.equal(1);
+                        expect(exampleAt(root, 0)->benchmark.samples).to.equal(0u);
+                    });
+            });
+        });
+        describe("property(<name>, <generator>..., <body>)", [] {
+            // evaluate the property and return it's error, empty when it passed
+            auto check = [](function<void()> spec, optional<uint64_t> seed = 1) {
+                detail::Options options;
+                options.seed = seed;
+                string error;
+                detail::tmp_spec(options, spec, [&](const detail::Statistics &, detail::ExampleGroup *root) {
+                    auto example = dynamic_cast<detail::Example *>(root->items[0].get());
+                    error = example->passed ? "" : example->error.what();
+                });
+                return error;
+            };
+            it("calls the body with values drawn from the generators in each case", [=] {
+                unsigned calls = 0;
+                expect(check([&] {
+                    property("bounds", gen::integers(-5, 7), gen::integers<uint8_t>(), gen::strings(gen::characters("ab"), 1, 3), [&](int i, uint8_t, const string &s) {
+                        ++calls;
+                        expect(i).to.be.within(-5, 7);
+                        expect(s.size()).to.be.within(1u, 3u);
+                        expect(s.find_first_not_of("ab")).to.equal(string::npos);
+                    });
+                })).to.equal("");
+                expect(calls).to.equal(100u);
+                calls = 0;
+                expect(check([&] { property("cases", gen::booleans(), [&](bool) { ++calls; }).cases(1000); })).to.equal("");
+                expect(calls).to.equal(1000u);
+            });
+            it("--seed=<n> draws the same cases", [=] {
+                auto draw = [=](uint64_t seed) {
+                    vector<vector<int>> drawn;
+                    check([&] { property("draw", gen::vectors(gen::integers(0, 1000)), [&](const vector<int> &v) { drawn.push_back(v); }); }, seed);
+                    return drawn;
+                };
+                expect(draw(7) == draw(7)).to.beTrue();
+                expect(draw(7) == draw(8)).to.beFalse();
+            });
+            it("shrinks integers towards 0", [=] {
+                expect(check([] { property("below 100", gen::integers(-1000, 1000), [](int i) { expect(abs(i)).to.be.below(100); }); }))
+                    .to.match(R"(expected 100 to be less than 100 for \(100\) \(case \d+ shrunk \d+ times, --seed=1\))");
+            });
+            it("shrinks containers by removing and shrinking elements", [=] {
+                expect(check([] {
+                    property("no element above 9", gen::vectors(gen::integers(0, 100)), [](const vector<int> &v) {
+                        for (auto i : v) {
+                            expect(i).to.be.below(10);
+                        }
+                    });
+                })).to.match(R"(expected 10 to be less than 10 for \(\{10\}\) .*)");
+                expect(check([] { property("no x", gen::strings(), [](const string &s) { expect(s.find('x')).to.equal(string::npos); }); }))
+                    .to.match(R"(expected 0 to equal \d+ for \("x"\) .*)");
+            });
+            it("shrinks user types", [=] {
+                expect(check([] {
+                    property("x below 10", gen::construct<Point>(gen::integers(0, 100), gen::integers(0, 100)),
+                             [](const Point &point) { expect(point.x).to.be.below(10); });
+                })).to.match(R"(expected 10 to be less than 10 for \(\(10, 0\)\) .*)");
+                expect(check([] {
+                    property("even", gen::integers(0, 100).map([](int i) { return i * 2; }).filter([](int i) { return i % 4 == 0; }),
+                             [](int i) { expect(i).to.be.below(20); });
+                })).to.match(R"(expected 20 to be less than 20 for \(20\) .*)");
+            });
+            it(".parallel(<n>) evaluates each case once and fails with the same case as on one thread", [=] {
+                atomic<unsigned> calls = 0;
+                expect(check([&] { property("parallel", gen::integers(), [&](int) { ++calls; }).cases(10000).parallel(4); })).to.equal("");
+                expect(calls.load()).to.equal(10000u);
+                auto rare = [](int i) { expect(i % 1000).to.not_().equal(999); };
+                auto serial = check([&] { property("rare", gen::integers(0, 1'000'000), rare).cases(100'000); });
+                auto parallel = check([&] { property("rare", gen::integers(0, 1'000'000), rare).cases(100'000).parallel(4); });
+                expect(serial).to.not_().equal("");
+                expect(parallel).to.equal(serial);
+            });
+            it(".parallel(<n>) counts the allocations of each case on it's own thread", [=] {
+                expect(check([] {
+                    property("allocates", gen::integers(1, 10), [](int n) {
+                        expect([=] {
+                            vector<int> values(n);
+                            doNotOptimize(values.data());
+                        }).to.allocateAtMost(1);
+                        expect([] {}).to.not_().allocate();
+                    }).parallel(4);
+                })).to.equal("");
+            });
+            it("error: matchSnapshot() in a .parallel(<n>) property", [=] {
+                expect(check([] { property("snapshot", gen::booleans(), [](bool b) { expect(b).to.matchSnapshot(); }).parallel(4); }))
+                    .to.match(R"(matchSnapshot\(\) can't be used in a property\(\) running it's cases in parallel for \(false\) .*)");
+            });
+            it("discards and replaces the cases gen::filter() rejected", [=] {
+                unsigned draws = 0, calls = 0;
+                // every other case rejects 100 values in a row
+                auto sometimes = gen::integers().filter([&](int) { return ++draws % 101 == 0; });
+                expect(check([&] { property("sometimes", sometimes, [&](int) { ++calls; }).cases(100'000); })).to.equal("");
+                expect(calls).to.equal(100'000u);
+            });
+            it("error: gen::filter() rejects too many values", [=] {
+                expect(check([] { property("never", gen::integers(0, 10).filter([](int i) { return i > 10; }), [](int) {}); }))
+                    .to.equal("gave up after 1001 discarded cases, gen::filter() rejected 100 values in a row (--seed=1)");
+            });
+            it("xproperty() skips and fproperty() focuses", [=] {
+                unsigned calls = 0;
+                detail::tmp_spec(
+                    detail::Options(),
+                    [&] {
+                        xproperty("skipped", gen::booleans(), [&](bool) { ++calls; });
+                        fproperty("focused", gen::booleans(), [&](bool) { calls += 1000; });
+                        property("other", gen::booleans(), [&](bool) { ++calls; });
+                    },
+                    [&](const detail::Statistics &statistics) { expect(statistics.numTotalTests).to.equal(1); });
+                expect(calls).to.equal(100'000u);
+            });
+        });
+        describe("resources: --top=<metric>[:<n>]", [] {
+            auto busy = [] {
+                for (unsigned i = 0; i < 10'000'000; ++i) {
+                    doNotOptimize(i);
+                }
+            };
+            it("records cpu time, page faults and context switches", [=] {
+                detail::tmp_spec(
+                    detail::Options(),
+                    [&] {
+                        it("busy", busy);
+                        it("faults", [] {
+                            size_t size = 16 << 20;
+                            auto memory = static_cast<char *>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+                            for (size_t i = 0; i < size; i += 4096) {
+                                memory[i] = 1;
+                            }
+                            munmap(memory, size);
+                        });
+                        it("sleeps", [] { this_thread::sleep_for(1ms); });
+                    },
+                    [&](const detail::Statistics &, detail::ExampleGroup *root) {
+                        auto resources = [&](size_t index) { return dynamic_cast<detail::Example *>(root->items[index].get())->resources; };
+                        expect(resources(0).user + resources(0).system).to.be.above(1ms);
+                        expect(resources(1).minorFaults).to.be.above(4);
+                        expect(resources(2).voluntarySwitches).to.be.above(0);
+                    });
+            });
+            it("prints the examples which used the most", [=] {
+                auto filename = (filesystem::temp_directory_path() / format("kaffeeklatsch-{}.top", getpid())).string();
+                {
+                    detail::TopReporter reporter("cpu", 1, detail::BufferedWriter::open(filename));
+                    detail::Options options;
+                    options.reporter = &reporter;
+                    detail::tmp_spec(
+                        options,
+                        [&] {
+                            it("idle", [] {});
+                            it("busy", busy);
+                        },
+                        [](const detail::Statistics &) {});
+                }
+                ifstream in(filename);
+                string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+                filesystem::remove(filename);
+                expect(content.c_str()).to.match(regex(R"(TOP 1 BY cpu:\n\n  \d+\.\dms  busy\n\n)"));
+            });
+            it("prints after the console's summary, else on stderr", [] {
+                expect(detail::topDestination({"console"})).to.equal("-");
+                expect(detail::topDestination({"junit:report.xml", "console"})).to.equal("-");
+                expect(detail::topDestination({"tap"})).to.equal("&2");
+                expect(detail::topDestination({"jsonl:report.jsonl"})).to.equal("&2");
+            });
+        });
+        describe("counters: --counters", [] {
+            auto faults = [] {
+                size_t size = 16 << 20;
+                auto memory = static_cast<char *>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+                for (size_t i = 0; i < size; i += 4096) {
+                    memory[i] = 1;
+                }
+                munmap(memory, size);
+            };
+            // perf_event_open() is linux only and may not be permitted, the hardware counters are often not accessible
+            it("takes the counters around each example", [=] {
+                detail::Options options;
+                options.counters = true;
+                detail::tmp_spec(
+                    options, [&] { it("faults", faults); },
+                    [&](const detail::Statistics &, detail::ExampleGroup *root) {
+                        auto &counters = dynamic_cast<detail::Example *>(root->items[0].get())->counters;
+                        if (counters.software) {
+                            expect(counters.pageFaults).to.be.above(4u);
+                            expect(counters.taskClock).to.be.above(0ns);
+                        }
+                        if (counters.hardware) {
+                            expect(counters.instructions).to.be.above(4096u);
+                            expect(counters.cycles).to.be.above(0u);
+                        }
+                    });
+            });
+            it("doesn't take the counters by default", [=] {
+                detail::tmp_spec(
+                    detail::Options(), [&] { it("faults", faults); },
+                    [&](const detail::Statistics &, detail::ExampleGroup *root) {
+                        auto &counters = dynamic_cast<detail::Example *>(root->items[0].get())->counters;
+                        expect(counters.software).to.beFalse();
+                        expect(counters.pageFaults).to.equal(0u);
+                    });
+            });
+            it("countEvents(<callable>)", [=] {
+                detail::Counters outer;
+                try {
+                    outer = countEvents(
+                        [&] {
+                            auto inner = countEvents(faults, Events::software);
+                            expect(inner.pageFaults).to.be.above(4u);
+                            faults();
+                        },
+                        Events::software);
+                } catch (assertion_error &error) {
+                    expect(string(error.what())).to.equal("countEvents() needs perf_event_open(), which isn't permitted");
+                    return;
+                }
+                expect(outer.pageFaults).to.be.above(8u);
+                if (outer.hardware) {
+                    expect(countEvents(faults).instructions).to.be.above(4096u);
+                }
+            });
+            it("error: countEvents(<callable>) without the hardware counters", [=] {
+                // the error of calling countEvents(), empty when it returned
+                auto error = [=](Events events) {
+                    try {
+                        countEvents(faults, events);
+                    } catch (assertion_error &error) {
+                        return string(error.what());
+                    }
+                    return string();
+                };
+                detail::hardwareEventsPermitted = false;
+                auto software = error(Events::software);
+                auto hardware = error(Events::hardware);
+                detail::hardwareEventsPermitted = true;
+                if (software.empty()) {
+                    expect(hardware).to.equal("countEvents() needs the hardware counters, which are unavailable, e.g. in containers");
+                } else {
+                    expect(hardware).to.equal(software);
+                }
+            });
+            it("error: countEvents(<callable>) without perf_event_open()", [=] {
+                detail::softwareEventsPermitted = false;
+                detail::hardwareEventsPermitted = false;
+                auto error = [=] {
+                    try {
+                        countEvents(faults, Events::software);
+                    } catch (assertion_error &error) {
+                        return string(error.what());
+                    }
+                    return string();
+                }();
+                detail::softwareEventsPermitted = true;
+                detail::hardwareEventsPermitted = true;
+                expect(error).to.equal("countEvents() needs perf_event_open(), which isn't permitted");
+            });
+        });
+        describe("baseline: --baseline=<file>, --save-baseline, --significance=<p>", [] {
+            auto loop = [](unsigned *work) {
+                return [=] {
+                    for (unsigned i = 0; i < *work; ++i) {
+                        doNotOptimize(i);
+                    }
+                };
+            };
+            auto measure = [=](unsigned work, detail::BaselineDatabase *baselines) {
+                detail::tmp_spec(
+                    detail::Options(), [&] { bench("loop", loop(&work)); },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numPassedTests).to.equal(1);
+                        baselines->update(root);
+                    });
+            };
+            it("fails a benchmark which is significantly slower than the baseline", [=] {
+                detail::BaselineDatabase baselines;
+                measure(100, &baselines);
+                unsigned work = 2000;
+                detail::Options options;
+                options.baselines = &baselines;
+                detail::tmp_spec(
+                    options, [&] { bench("loop", loop(&work)); },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numFailedTests).to.equal(1);
+                        auto example = dynamic_cast<detail::Example *>(root->items[0].get());
+                        expect(example->error.what()).to.match(regex(R"(^\d+\.\d% slower \(p=.*\)$)"));
+                    });
+            });
+            it("--regression-threshold=<percent>% passes a significant shift below the threshold", [=] {
+                // the error of comparing the samples with the baseline, empty when it passed
+                auto compare = [](vector<double> samples, vector<double> baseline, double threshold) {
+                    detail::Example example(nullptr, "bench", [] {});
+                    example.benchmark.samples = samples.size();
+                    copy(samples.begin(), samples.end(), example.benchmark.values.begin());
+                    example.baseline = baseline;
+                    example.m_threshold = threshold;
+                    example.compareWithBaseline();
+                    return example.passed ? string() : string(example.error.what());
+                };
+                vector<double> baseline = {100, 100.1, 100.2, 100.3, 100.4, 100.5, 100.6, 100.7, 100.8, 100.9}, slower;
+                for (auto sample : baseline) {
+                    slower.push_back(sample + 2);
+                }
+                expect(compare(slower, baseline, 0.05)).to.equal("");
+                expect(compare(slower, baseline, 0.01)).to.match(R"(^2\.0% slower \(p=.*\)$)");
+                expect(compare(baseline, slower, 0.0)).to.equal("");
+                expect(compare(vector<double>(10, 10), vector<double>(10, 0), 0.05)).to.match(R"(^10\.0ns slower \(p=.*\)$)");
+            });
+            it("passes a benchmark which is faster than the baseline", [=] {
+                detail::BaselineDatabase baselines;
+                measure(2000, &baselines);
+                unsigned work = 100;
+                detail::Options options;
+                options.baselines = &baselines;
+                detail::tmp_spec(
+                    options, [&] { bench("loop", loop(&work)); },
+                    [&](const detail::Statistics &statistics) { expect(statistics.numPassedTests).to.equal(1); });
+            });
+        });
+        describe("snapshots: .matchSnapshot(), --snapshots=<file>, --update-snapshots", [] {
+            // evaluate an example matching the outputs with it's snapshots, the error when it failed
+            auto match = [](detail::SnapshotStore *snapshots, vector<string> outputs, bool isolate = false) {
+                detail::Options options;
+                options.snapshotStore = snapshots;
+                options.isolate = isolate;
+                string error;
+                detail::tmp_spec(
+                    options,
+                    [&] {
+                        describe("renderer", [&] {
+                            it("renders", [&] {
+                                for (auto &output : outputs) {
+                                    expect(output).to.matchSnapshot();
+                                }
+                            });
+                        });
+                    },
+                    [&](const detail::Statistics &, detail::ExampleGroup *root) {
+                        auto group = dynamic_cast<detail::ExampleGroup *>(root->items[0].get());
+                        auto example = dynamic_cast<detail::Example *>(group->items[0].get());
+                        error = example->passed ? "" : example->error.what();
+                        if (snapshots) {
+                            snapshots->prune(root);
+                        }
+                    });
+                return error;
+            };
+            it("records the snapshots in the first run and compares with them in later runs", [=] {
+                detail::SnapshotStore snapshots;
+                expect(match(&snapshots, {"hello", "world"})).to.equal("");
+                expect(snapshots.changed()).to.beTrue();
+                expect(match(&snapshots, {"hello", "world"})).to.equal("");
+                expect(match(&snapshots, {"hello", "word"})).to.equal("snapshot 2 differs, expected \"word\" to equal \"world\"");
+            });
+            it("records empty snapshots", [=] {
+                detail::SnapshotStore snapshots;
+                expect(match(&snapshots, {""})).to.equal("");
+                expect(match(&snapshots, {""})).to.equal("");
+                expect(match(&snapshots, {"x"})).to.equal("snapshot 1 differs, expected \"x\" to equal \"\"");
+            });
+            it("records other values as they are shown in failure messages", [] {
+                detail::SnapshotStore snapshots;
+                detail::Options options;
+                options.snapshotStore = &snapshots;
+                auto match = [&](vector<int> value) {
+                    string error;
+                    detail::tmp_spec(
+                        options, [&] { it("renders", [&] { expect(value).to.matchSnapshot(); }); },
+                        [&](const detail::Statistics &, detail::ExampleGroup *root) {
+                            auto example = dynamic_cast<detail::Example *>(root->items[0].get());
+                            error = example->passed ? "" : example->error.what();
+                        });
+                    return error;
+                };
+                expect(match({1, 2, 3})).to.equal("");
+                expect(match({1, 2, 4})).to.equal("snapshot 1 differs, expected \"{1, 2, 4}\" to equal \"{1, 2, 3}\"");
+            });
+            it("shows the difference of binary snapshots as hexdump", [] {
+                detail::SnapshotStore snapshots;
+                expect(snapshots.match(1, 1, string_view("\x01\x02\x03", 3), false).has_value()).to.beFalse();
+                expect(*snapshots.match(1, 1, string_view("\x01\x07\x03", 3), false))
+                    .to.equal("snapshot 1 differs, expected 3 bytes to equal 3 bytes, first difference at offset 0x1 (- expected, + actual):\n"
+                              "  - 00000000  01 02 03                                          |...|\n"
+                              "  + 00000000  01 07 03                                          |...|\n"
+                              "                 ^^");
+            });
+            it("save() and load() map the file", [] {
+                auto filename = (filesystem::temp_directory_path() / format("kaffeeklatsch-{}.snapshots", getpid())).string();
+                string large(1 << 20, 'x');
+                {
+                    detail::SnapshotStore out;
+                    out.match(2, 1, "small", true);
+                    out.match(2, 2, large, true);
+                    expect(out.save(filename)).to.beTrue();
+                }
+                detail::SnapshotStore in;
+                expect(in.load(filename)).to.beTrue();
+                filesystem::remove(filename);
+                expect(in.changed()).to.beFalse();
+                expect(in.match(2, 1, "small", true).has_value()).to.beFalse();
+                expect(in.match(2, 2, large, true).has_value()).to.beFalse();
+                expect(in.changed()).to.beFalse();
+                large[1000] = 'y';
+                expect(in.match(2, 2, large, true).has_value()).to.beTrue();
+                expect(in.load(filename)).to.beFalse();
+                std::ofstream(filename) << "kksn garbage";
+                expect(in.load(filename)).to.beFalse();
+                filesystem::remove(filename);
+            });
+            it("--update-snapshots replaces the snapshots which differ", [=] {
+                detail::SnapshotStore snapshots;
+                expect(match(&snapshots, {"hello"})).to.equal("");
+                snapshots.update = true;
+                expect(match(&snapshots, {"hallo"})).to.equal("");
+                snapshots.update = false;
+                expect(match(&snapshots, {"hallo"})).to.equal("");
+            });
+            it("forgets the snapshots examples which passed didn't match and those of examples which don't exist", [=] {
+                detail::SnapshotStore snapshots;
+                snapshots.match(3, 1, "old", true);
+                expect(match(&snapshots, {"a", "b"})).to.equal("");
+                expect(match(&snapshots, {"x"})).to.equal("snapshot 1 differs, expected \"x\" to equal \"a\"");
+                expect(match(&snapshots, {"a", "c"})).to.equal("snapshot 2 differs, expected \"c\" to equal \"b\"");
+                expect(match(&snapshots, {"a"})).to.equal("");
+                expect(match(&snapshots, {"a", "c"})).to.equal("");
+                expect(snapshots.match(3, 1, "new", true).has_value()).to.beFalse();
+            });
+            it("--isolate passes the snapshots recorded by the workers on", [=] {
+                lock_guard lock(forking);
+                detail::SnapshotStore snapshots;
+                expect(match(&snapshots, {"hello"}, true)).to.equal("");
+                expect(match(&snapshots, {"hallo"})).to.equal("snapshot 1 differs, expected \"hallo\" to equal \"hello\"");
+            });
+            it("error: siblings with the same name", [=] {
+                detail::SnapshotStore snapshots;
+                detail::Options options;
+                options.snapshotStore = &snapshots;
+                detail::tmp_spec(
+                    options,
+                    [] {
+                        describe("renderer", [] {
+                            it("renders", [] { expect(string("a")).to.matchSnapshot(); });
+                            it("renders", [] { expect(string("b")).to.matchSnapshot(); });
+                            it("renders too", [] { expect(string("c")).to.matchSnapshot(); });
+                        });
+                    },
+                    [&](const detail::Statistics &statistics, detail::ExampleGroup *root) {
+                        expect(statistics.numFailedTests).to.equal(2);
+                        auto group = dynamic_cast<detail::ExampleGroup *>(root->items[0].get());
+                        expect(string(dynamic_cast<detail::Example *>(group->items[0].get())->error.what()))
+                            .to.equal("matchSnapshot() needs a unique path but 'renderer > renders' is declared more than once");
+                    });
+            });
+            it("error: without snapshots", [=] {
+                expect(match(nullptr, {"hello"})).to.equal("matchSnapshot() needs the snapshots, which are disabled with --snapshots=");
+            });
+        });
     });
 
     describe("expect(<actual>)", [] {
+        describe("expect(<lvalue>) and expect(<temporary>)", [] {
+            it("doesn't copy lvalues", [] {
+                Copies original, expected;
+                expect(original).to.equal(expected);
+                expect(original).to.not_().equal(Copies{1});
+                expect(original.copies + expected.copies).to.equal(0u);
+            });
+            it("owns temporaries", [] {
+                auto make = [] { return vector<string>(1000, string(100, 'x')); };
+                expect(make()).to.have.sizeOf(1000).and_.contain(string(100, 'x'));
+            });
+            it("move-only types", [] {
+                auto pointer = make_unique<int>(42);
+                expect(pointer).to.not_().equal(nullptr);
+                expect(make_unique<int>(7)).to.not_().equal(nullptr);
+                expect(unique_ptr<int>()).to.equal(nullptr);
+            });
+            it("callables", [] {
+                unsigned calls = 0;
+                auto count = [&calls]() mutable { ++calls; };
+                expect(count).to.not_().throw_();
+                expect([&] { ++calls; }).to.not_().throw_();
+                expect(calls).to.equal(2u);
+            });
+            it("string literals decay to const char*", [] {
+                expect("abc").to.match("a.c");
+                expect("abc").to.not_().equal(nullptr);
+            });
+        });
+
         describe(".<chain>", [] {
             it("to", [] { expect(1).to.equal(1); });
             it("be", [] { expect(1).be.equal(1); });
@@ -321,6 +1540,76 @@ kaffeeklatsch_spec([] {
                     expect(M1).eq(M2);
                 }).to.throw_(assertion_error("expected 1 to equal 2", "", 0));
             });
+            it("error: sequences show a diff of the elements around the differences", [] {
+                vector<int> expected(1000);
+                iota(expected.begin(), expected.end(), 0);
+                auto actual = expected;
+                actual[500] = -1;
+                actual.insert(actual.begin() + 900, 42);
+                expect([&] {
+                    expect(actual).to.equal(expected);
+                }).to.throw_(assertion_error("expected 1001 elements to equal 1000 elements, first difference at index 500 (- expected, + actual):\n"
+                                             "  ...\n    497\n    498\n    499\n  - 500\n  + -1\n    501\n    502\n    503\n"
+                                             "  ...\n    897\n    898\n    899\n  + 42\n    900\n    901\n    902\n  ...",
+                                             "", 0));
+                expect(actual).to.not_().equal(expected);
+                expect(expected).to.equal(vector<int>(expected));
+            });
+            it("error: the diff gives up after 100 differences", [] {
+                vector<int> expected(1000);
+                iota(expected.begin(), expected.end(), 0);
+                vector<int> actual(expected.rbegin(), expected.rend());
+                expect([&] {
+                    expect(actual).to.equal(expected);
+                }).to.throw_(assertion_error("expected 1000 elements to equal 1000 elements, first difference at index 0 (- expected, + actual):\n"
+                                             "  - 0\n  - 1\n  - 2\n  + 999\n  + 998\n  + 997\n  ... more than 100 differences",
+                                             "", 0));
+            });
+            it("error: long sequences differing at both ends only diff a window after the first difference", [] {
+                vector<int> expected(1000000);
+                iota(expected.begin(), expected.end(), 0);
+                auto actual = expected;
+                actual[0] = -1;
+                actual.back() = -1;
+                expect([&] {
+                    expect(actual).to.equal(expected);
+                }).to.throw_(assertion_error("expected 1000000 elements to equal 1000000 elements, first difference at index 0 (- expected, + actual):\n"
+                                             "  - 0\n  + -1\n    1\n    2\n    3\n  ...",
+                                             "", 0));
+            });
+            it("error: long sequences don't list their elements when they are equal", [] {
+                vector<int> expected(1000000);
+                expect([&] {
+                    expect(vector<int>(expected)).to.not_().equal(expected);
+                }).to.throw_(assertion_error("expected 1000000 elements to not equal 1000000 elements", "", 0));
+            });
+            it("error: long strings show the first difference", [] {
+                string expected(1000, 'a');
+                auto actual = expected;
+                actual[500] = 'b';
+                auto window = string(32, 'a') + "b" + string(31, 'a');
+                expect([&] {
+                    expect(actual).to.equal(expected);
+                }).to.throw_(assertion_error(format("expected ...\"{}\"... to equal ...\"{}\"..., first difference at index 500 (1000 and 1000 characters)",
+                                                    window, string(64, 'a')),
+                                             "", 0));
+                expect([&] {
+                    expect(string_view(expected)).to.not_().equal(string_view(expected));
+                }).to.throw_(assertion_error(format("expected \"{0}...\" (1000 characters) to not equal \"{0}...\" (1000 characters)", string(64, 'a')),
+                                             "", 0));
+            });
+            it("error: multi-line strings show a diff of the lines", [] {
+                string expected, actual;
+                for (int i = 0; i < 100; ++i) {
+                    expected += format("line {}\n", i);
+                    actual += i == 50 ? "changed\n" : format("line {}\n", i);
+                }
+                expect([&] {
+                    expect(actual).to.equal(expected);
+                }).to.throw_(assertion_error("expected 101 lines to equal 101 lines, first difference in line 51 (- expected, + actual):\n"
+                                             "  ...\n    line 47\n    line 48\n    line 49\n  - line 50\n  + changed\n    line 51\n    line 52\n    line 53\n  ...",
+                                             "", 0));
+            });
         });
 
         describe("gt", [] {
@@ -440,6 +1729,30 @@ kaffeeklatsch_spec([] {
                         expect("hello").to.match("^HELLO$");
                     }).to.throw_(assertion_error("expected \"hello\" to match /^HELLO$/", "", 0));
                 });
+                it("std::string and std::string_view", [] {
+                    std::string text("hello");
+                    expect(text).to.match("^hel+o$");
+                    expect(std::string_view(text).substr(1, 3)).to.match("el+");
+                    expect([] {
+                        // prettier-ignore
+                        expect(std::string_view("hello world").substr(6)).to.match("^hello$");
+                    }).to.throw_(assertion_error("expected \"world\" to match /^hello$/", "", 0));
+                });
+                it("compiles each pattern once", [] {
+                    expect(&detail::compiledRegex("^a+$")).to.equal(&detail::compiledRegex(std::string("^a+$")));
+                    expect(&detail::compiledRegex("^a+$")).to.not_().equal(&detail::compiledRegex("^b+$"));
+                });
+                it("keeps the most recently used patterns only", [] {
+                    auto first = &detail::compiledRegex("^first$");
+                    for (unsigned i = 0; i < 32; ++i) {
+                        detail::compiledRegex(format("^{}$", i));
+                        expect(&detail::compiledRegex("^first$")).to.equal(first);
+                    }
+                    for (unsigned i = 0; i < 32; ++i) {
+                        detail::compiledRegex(format("^{}$", i + 32));
+                    }
+                    expect(regex_match("first", detail::compiledRegex("^first$"))).to.beTrue();
+                });
             });
             describe("match(std::regex)", []{
                 it("okay", []{
@@ -462,6 +1775,21 @@ kaffeeklatsch_spec([] {
                         expect("hello").to.be.uuid();
                     }).to.throw_(assertion_error("expected \"hello\" to be a UUID", "", 0));
                 });
+                it("std::string and std::string_view", [] {
+                    expect(std::string("123E4567-E89B-12D3-A456-426655440000")).to.be.uuid();
+                    expect(std::string_view("{123e4567-e89b-12d3-a456-426655440000}").substr(1, 36)).to.be.uuid();
+                });
+                it("checks the length, the hex digits and the position of the dashes", [] {
+                    expect("123e4567-e89b-12d3-a456-42665544000").to.not_().be.uuid();
+                    expect("123e4567-e89b-12d3-a456-4266554400000").to.not_().be.uuid();
+                    expect("123e4567-e89b-12d3-a456-42665544000g").to.not_().be.uuid();
+                    expect("123e4567e-89b-12d3-a456-426655440000").to.not_().be.uuid();
+                    expect("123e4567-e89b-12d3-a456+426655440000").to.not_().be.uuid();
+                    expect([] {
+                        // prettier-ignore
+                        expect("123e4567-e89b-12d3-a456-426655440000").to.not_().be.uuid();
+                    }).to.throw_(assertion_error("expected \"123e4567-e89b-12d3-a456-426655440000\" to not be a UUID", "", 0));
+                });
             });
         });
         describe("container", [] {
@@ -542,6 +1870,371 @@ kaffeeklatsch_spec([] {
                     expect(v1).contains(3);
                 });
             });
+            describe(".containAll(<expected>), .containAny(<expected>), .haveSameMembers(<expected>)", [] {
+                it(".containAll(<expected>)", [] {
+                    vector<int> v1{1, 2, 3, 4};
+                    expect(v1).to.containAll({4, 2});
+                    expect(v1).to.containAll(set<int>{1, 3});
+                    expect(v1).to.not_().containAll({4, 5});
+                    vector<int> many(100000);
+                    iota(many.begin(), many.end(), 0);
+                    vector<int> reversed(many.rbegin(), many.rend());
+                    expect(many).to.containAll(reversed);
+                });
+                it("error .containAll(...): lists the first missing elements", [] {
+                    vector<int> v1(100);
+                    iota(v1.begin(), v1.end(), 0);
+                    vector<int> v2(200);
+                    iota(v2.begin(), v2.end(), 0);
+                    expect([&] {
+                        expect(v1).to.containAll(v2);
+                    }).to.throw_(assertion_error("expected to contain all of 200 elements but 100 are missing: 100, 101, 102, 103, 104, 105, 106, 107, 108, 109 and 90 more", "", 0));
+                    expect([&] {
+                        expect(v1).to.not_().containAll({1, 2});
+                    }).to.throw_(assertion_error("expected to not contain all of 2 elements", "", 0));
+                });
+                it(".containAny(<expected>)", [] {
+                    vector<string> v1{"a", "b", "c"};
+                    expect(v1).to.containAny({"x", "b"});
+                    expect(v1).to.not_().containAny({"x", "y"});
+                    expect([&] {
+                        expect(v1).to.containAny({"x", "y"});
+                    }).to.throw_(assertion_error("expected to contain any of 2 elements but contains none", "", 0));
+                    expect([&] {
+                        expect(v1).to.not_().containAny({"x", "c", "a"});
+                    }).to.throw_(assertion_error("expected to not contain any of 3 elements but contains 2: \"c\", \"a\"", "", 0));
+                });
+                it(".haveSameMembers(<expected>)", [] {
+                    vector<int> v1{3, 1, 2, 1};
+                    expect(v1).to.haveSameMembers({1, 1, 2, 3});
+                    expect(v1).to.not_().haveSameMembers({1, 2, 3});
+                    expect([&] {
+                        expect(v1).to.haveSameMembers({1, 2, 3});
+                    }).to.throw_(assertion_error("expected the same members but 1 are extra: 1", "", 0));
+                    expect([&] {
+                        expect(v1).to.haveSameMembers({1, 2, 4, 5});
+                    }).to.throw_(assertion_error("expected the same members but 2 are missing: 4, 5; 2 are extra: 3, 1", "", 0));
+                });
+                it("orders elements without std::hash<>", [] {
+                    struct Point {
+                            int x, y;
+                            bool operator==(const Point&) const = default;
+                            bool operator<(const Point& other) const { return pair{x, y} < pair{other.x, other.y}; }
+                    };
+                    vector<Point> v1{{1, 2}, {3, 4}};
+                    expect(v1).to.containAll({{3, 4}});
+                    expect(v1).to.haveSameMembers({{3, 4}, {1, 2}});
+                    expect(v1).to.be.beUnique();
+                });
+            });
+            describe(".beSorted(), .beUnique()", [] {
+                it("okay", [] {
+                    expect(vector<int>{1, 2, 2, 3}).to.beSorted();
+                    expect(vector<int>{1, 3, 2}).to.not_().beSorted();
+                    expect(vector<int>{}).to.beSorted();
+                    expect(list<string>{"b", "a", "c"}).to.beUnique();
+                    expect(vector<int>{1, 2, 1}).to.not_().beUnique();
+                });
+                it("error", [] {
+                    expect([] {
+                        expect(vector<int>{1, 3, 5, 4, 6}).to.beSorted();
+                    }).to.throw_(assertion_error("expected to be sorted but 4 at index 3 is less than 5", "", 0));
+                    expect([] {
+                        expect(vector<int>{1, 2, 1, 3, 2, 1}).to.beUnique();
+                    }).to.throw_(assertion_error("expected to be unique but 2 are duplicated: 1, 2", "", 0));
+                    expect([] {
+                        expect(vector<int>{1, 2}).to.not_().beUnique();
+                    }).to.throw_(assertion_error("expected to not be unique", "", 0));
+                });
+            });
+        });
+
+        describe(".closeTo(<expected>, <abs>, <rel>), .withinUlps(<expected>, <ulps>)", [] {
+            it("okay", [] {
+                expect(0.1 + 0.2).to.be.closeTo(0.3, 1e-12);
+                expect(1000001.0).to.be.closeTo(1000000.0, 0, 1e-6);
+                expect(1.1).to.not_().be.closeTo(1.0, 0.01);
+                expect(0.1f + 0.2f).to.be.withinUlps(0.3f, 1);
+                expect(0.0).to.be.withinUlps(-0.0, 0);
+                expect(nextafter(1.0, 2.0)).to.be.withinUlps(1.0, 1).and_.to.not_().be.withinUlps(1.0, 0);
+                expect(NAN).to.not_().be.withinUlps(NAN, 1000);
+            });
+            it("error: scalars", [] {
+                expect([] {
+                    expect(1.5).to.be.closeTo(1.0, 0.25);
+                }).to.throw_(assertion_error("expected 1.5 to be close to 1 but differs by 0.5, more than 0.25", "", 0));
+                expect([] {
+                    expect(1.0).to.not_().be.closeTo(1.0, 0.25);
+                }).to.throw_(assertion_error("expected 1 to not be close to 1", "", 0));
+                expect([] {
+                    expect(nextafter(nextafter(1.0, 2.0), 2.0)).to.be.withinUlps(1.0, 1);
+                }).to.throw_(assertion_error("expected 1.0000000000000004 to be within 1 ULPs of 1 but is 2 ULPs away", "", 0));
+            });
+            it("ranges", [] {
+                vector<float> expected(1 << 20);
+                iota(expected.begin(), expected.end(), 0.0f);
+                auto actual = expected;
+                for (auto& value : actual) {
+                    value = nextafter(value, numeric_limits<float>::infinity());
+                }
+                expect(actual).to.be.closeTo(expected, 1e-30, 1e-6);
+                expect(actual).to.be.withinUlps(expected, 1);
+                expect(span<const float>(actual)).to.not_().be.withinUlps(expected, 0);
+            });
+            it("error: ranges report the number of mismatches, the worst and the max error", [] {
+                vector<double> expected(5000, 1.0);
+                auto actual = expected;
+                actual[10] = 1.5;
+                actual[3000] = 0.0;
+                actual[4999] = -1.0;
+                expect([&] {
+                    expect(actual).to.be.closeTo(expected, 0.1);
+                }).to.throw_(assertion_error(
+                    "expected 5000 elements to be close but 3 differ by more than abs 0.1 or rel 0, the worst at index 4999 with -1 instead of 1, the max error is 2",
+                    "", 0));
+                actual = expected;
+                actual[7] = NAN;
+                actual[8] = nextafter(nextafter(1.0, 2.0), 2.0);
+                expect([&] {
+                    expect(actual).to.be.withinUlps(expected, 1);
+                }).to.throw_(assertion_error(
+                    "expected 5000 elements to be close but 2 differ by more than 1 ULPs, the worst at index 7 with nan instead of 1, the max error is nan ULPs", "",
+                    0));
+                expect([&] {
+                    expect(actual).to.be.closeTo(vector<double>(10), 0.1);
+                }).to.throw_(assertion_error("expected 5000 elements to be close to 10 elements", "", 0));
+                expect([&] {
+                    expect(expected).to.not_().be.closeTo(expected, 0.1);
+                }).to.throw_(assertion_error("expected 5000 elements to not be close to 5000 elements", "", 0));
+            });
+        });
+
+        describe(".equalBytes(<bytes>), .startWithBytes(<bytes>), .containBytes(<bytes>)", [] {
+            it("okay", [] {
+                vector<uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', 0, 0};
+                vector<byte> bytes(png.size());
+                memcpy(bytes.data(), png.data(), png.size());
+                expect(png).to.equalBytes(bytes);
+                expect(span<const byte>(bytes)).to.startWithBytes({0x89, 'P', 'N', 'G'});
+                expect(png).to.containBytes(string("\r\n"));
+                expect(png).to.not_().containBytes({'\r', '\r'});
+                expect(png).to.containBytes(vector<uint8_t>{});
+                vector<byte> large(1 << 20);
+                large.back() = byte{1};
+                expect(large).to.containBytes({0, 1});
+            });
+            it("error: .equalBytes() shows a hexdump around the first difference", [] {
+                vector<uint8_t> expected(64);
+                iota(expected.begin(), expected.end(), 0);
+                auto actual = expected;
+                actual[35] = 0xff;
+                actual.push_back(1);
+                expect([&] {
+                    expect(actual).to.equalBytes(expected);
+                }).to.throw_(assertion_error("expected 65 bytes to equal 64 bytes, first difference at offset 0x23 (- expected, + actual):\n"
+                                             "  ...\n"
+                                             "    00000010  10 11 12 13 14 15 16 17  18 19 1a 1b 1c 1d 1e 1f  |................|\n"
+                                             "  - 00000020  20 21 22 23 24 25 26 27  28 29 2a 2b 2c 2d 2e 2f  | !\"#$%&'()*+,-./|\n"
+                                             "  + 00000020  20 21 22 ff 24 25 26 27  28 29 2a 2b 2c 2d 2e 2f  | !\".$%&'()*+,-./|\n"
+                                             "                       ^^\n"
+                                             "    00000030  30 31 32 33 34 35 36 37  38 39 3a 3b 3c 3d 3e 3f  |0123456789:;<=>?|\n"
+                                             "  + 00000040  01                                                |.|\n"
+                                             "              ^^",
+                                             "", 0));
+                expect([&] {
+                    expect(expected).to.not_().equalBytes(expected);
+                }).to.throw_(assertion_error("expected 64 bytes to not equal 64 bytes", "", 0));
+            });
+            it("error: .startWithBytes()", [] {
+                expect([] {
+                    expect(vector<uint8_t>{0, 1, 2, 3}).to.startWithBytes({0, 1, 3});
+                }).to.throw_(assertion_error("expected 4 bytes to start with 00 01 03, first difference at offset 0x2 (- expected, + actual):\n"
+                                             "  - 00000000  00 01 03                                          |...|\n"
+                                             "  + 00000000  00 01 02                                          |...|\n"
+                                             "                    ^^",
+                                             "", 0));
+                expect([] {
+                    expect(vector<uint8_t>{0}).to.startWithBytes({0, 1});
+                }).to.throw_(assertion_error("expected 1 bytes to start with 00 01, first difference at offset 0x1 (- expected, + actual):\n"
+                                             "  - 00000000  00 01                                             |..|\n"
+                                             "  + 00000000  00                                                |.|\n"
+                                             "                 ^^",
+                                             "", 0));
+            });
+            it("error: .containBytes()", [] {
+                string request = "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\n";
+                expect([&] {
+                    expect(request).to.containBytes({0xde, 0xad});
+                }).to.throw_(assertion_error("expected 47 bytes to contain de ad", "", 0));
+                expect([&] {
+                    expect(request).to.not_().containBytes(string("example"));
+                }).to.throw_(assertion_error("expected 47 bytes to not contain 65 78 61 6d 70 6c 65 but found them at offset 0x20:\n"
+                                             "  ...\n"
+                                             "    00000010  48 54 54 50 2f 31 2e 31  0d 0a 48 6f 73 74 3a 20  |HTTP/1.1..Host: |\n"
+                                             "    00000020  65 78 61 6d 70 6c 65 2e  63 6f 6d 0d 0a 0d 0a     |example.com....|\n"
+                                             "              ^^ ^^ ^^ ^^ ^^ ^^ ^^",
+                                             "", 0));
+            });
+        });
+
+        describe(".completeWithin(<duration>), .haveP50Below(<duration>), .haveP99Below(<duration>)", [] {
+            auto failure = [](auto assertion) -> string {
+                try {
+                    assertion();
+                } catch (assertion_error &error) {
+                    return error.what();
+                }
+                return "";
+            };
+            it("okay", [] {
+                expect([] {}).to.completeWithin(5ms);
+                expect([] {}).to.haveP50Below(5ms);
+                expect([] {}).to.haveP99Below(5ms);
+                expect([] { this_thread::sleep_for(1ms); }).samples(5).to.not_().completeWithin(500us);
+            });
+            it("error: expected p99 latency <value> to be within <limit>", [=] {
+                auto what = failure([] { expect([] { this_thread::sleep_for(1ms); }).samples(5).to.completeWithin(500us); });
+                expect(what.c_str()).to.match(R"(expected p99 latency \d+\.\dms to be within 500\.0us \(5 samples\))");
+            });
+            it("asserts on the percentile and not a single sample", [=] {
+                unsigned calls = 0;
+                auto onceSlow = [&] {
+                    if (++calls == 50) {
+                        this_thread::sleep_for(2ms);
+                    }
+                };
+                expect(onceSlow).to.completeWithin(1ms);
+                calls = 0;
+                auto sometimesSlow = [&] {
+                    if (++calls % 50 == 0) {
+                        this_thread::sleep_for(2ms);
+                    }
+                };
+                expect(sometimesSlow).to.haveP50Below(1ms);
+                expect(sometimesSlow).to.haveP90Below(1ms);
+                expect(calls).to.equal(202u);
+                expect(failure([&] { expect(sometimesSlow).to.completeWithin(1ms); })).to.match(R"(expected p99 latency .*)");
+                auto what = failure([&] { expect(sometimesSlow).to.haveP99Below(1ms); });
+                expect(what.c_str()).to.match(R"(expected p99 latency \d+\.\dms to be below 1\.0ms \(100 samples\))");
+                expect(failure([&] { expect(sometimesSlow).samples(1000).havePercentileBelow(99.5, 50ms); })).to.equal("");
+            });
+        });
+
+        describe(".allocate(), .allocateAtMost(<n>), .allocateAtMostBytes(<n>)", [] {
+            it("okay", [] {
+                expect([] {
+                    int value = 1;
+                    doNotOptimize(value);
+                }).to.not_().allocate();
+                expect([] {
+                    vector<int> values(3);
+                    doNotOptimize(values.data());
+                }).to.allocate();
+                expect([] {
+                    vector<int> values(3);
+                    doNotOptimize(values.data());
+                }).to.allocateAtMost(1).and_.allocateAtMostBytes(3 * sizeof(int));
+            });
+            it("error: expected to not allocate", [] {
+                expect([] {
+                    // prettier-ignore
+                    expect([] {
+                        vector<int> values(3);
+                        doNotOptimize(values.data());
+                    }).to.not_().allocate();
+                }).to.throw_(assertion_error("expected to not allocate but allocated 1 times (12 bytes)", "", 0));
+            });
+            it("error: expected at most <n> allocations", [] {
+                expect([] {
+                    // prettier-ignore
+                    expect([] {
+                        vector<int> values(3);
+                        doNotOptimize(values.data());
+                        values.resize(100);
+                        doNotOptimize(values.data());
+                    }).to.allocateAtMost(1);
+                }).to.throw_(assertion_error("expected at most 1 allocations but allocated 2 times (412 bytes)", "", 0));
+            });
+            it("error: expected to allocate at most <n> bytes", [] {
+                expect([] {
+                    // prettier-ignore
+                    expect([] {
+                        vector<int> values(3);
+                        doNotOptimize(values.data());
+                    }).to.allocateAtMostBytes(8);
+                }).to.throw_(assertion_error("expected to allocate at most 8 bytes but allocated 12 bytes (1 times)", "", 0));
+            });
+            it("counts the allocations of the calling thread only", [] {
+                expect([] {
+                    thread worker([] {
+                        vector<int> values(1000);
+                        doNotOptimize(values.data());
+                    });
+                    worker.join();
+                }).to.allocateAtMostBytes(1000);
+            });
+        });
+
+        describe("expect(<sizes>, <fn>).to.scale.<complexity>()", [] {
+            auto linear = [](size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    doNotOptimize(i);
+                }
+            };
+            auto quadratic = [](size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    for (size_t j = 0; j < n; ++j) {
+                        doNotOptimize(j);
+                    }
+                }
+            };
+            auto allocating = [](size_t n) {
+                list<size_t> values;
+                for (size_t i = 0; i < n; ++i) {
+                    values.push_back(i);
+                }
+            };
+            it("geometric(<first>, <last>)", [] {
+                expect(geometric(1000, 8000)).to.equal(vector<size_t>{1000, 2000, 4000, 8000});
+                expect(geometric(1, 100, 10)).to.equal(vector<size_t>{1, 10, 100});
+            });
+            it("okay", [=] {
+                expect(geometric(1000, 64000), linear).to.scale.linearly();
+                expect(geometric(100, 1600), quadratic).to.scale.quadratically();
+                expect(geometric(100, 1600), [](size_t n) { doNotOptimize(n); }).to.scale.constant();
+                expect(geometric(1000, 64000), linear).to.not_().scale.quadratically();
+            });
+            it("allocations()", [=] {
+                expect(geometric(100, 1600), allocating).allocations().to.scale.linearly();
+                expect(geometric(100, 1600), [](size_t n) { vector<size_t> values(n); }).allocations().to.scale.constant();
+            });
+            it("error: expected to scale with <complexity> but they fit <complexity> best", [=] {
+                try {
+                    expect(geometric(100, 1600), allocating).allocations().to.scale.constant();
+                } catch (assertion_error &error) {
+                    expect(error.what()).to.match(R"(expected allocations to scale with O\(1\) but they fit O\(n\) best \(rms error O\(1\) .*%, .*\))");
+                    return;
+                }
+                throw assertion_error("no exception", __FILE__, __LINE__);
+            });
+            it("error: no allocations at all only scale constant", [=] {
+                auto none = [](size_t n) { doNotOptimize(n); };
+                expect(geometric(100, 1600), none).allocations().to.scale.constant();
+                expect(geometric(100, 1600), none).allocations().to.not_().scale.linearly();
+                expect(geometric(100, 1600), none).allocations().to.not_().scale.quadratically();
+                expect([=] {
+                    // prettier-ignore
+                    expect(geometric(100, 1600), none).allocations().to.scale.linearly();
+                }).to.throw_(assertion_error("expected allocations to scale with O(n) but they fit O(1) best (rms error O(1) 0.0%, O(log n) 100.0%, O(n) 100.0%, "
+                                             "O(n log n) 100.0%, O(n²) 100.0%)",
+                                             "", 0));
+            });
+            it("error: needs at least 3 sizes", [=] {
+                expect([=] {
+                    // prettier-ignore
+                    expect({10, 20}, linear).to.scale.linearly();
+                }).to.throw_(assertion_error("expected at least 3 sizes to fit the complexity", "", 0));
+            });
         });
 
         describe(".throws(<expected>)", [] {
@@ -625,5 +2318,321 @@ kaffeeklatsch_spec([] {
             it("to_str(string(\"c++ string\")) -> \"c++ string\"", [] { expect(to_str("c++ string")).to.equal("\"c++ string\""); });
             it("to_str(vector{1,2,3,4}) -> object", [] { expect(to_str(vector{1, 2, 3, 4})).to.equal("object"); });
         });
+        describe("firstMismatch(a, b, size)", [] {
+            it("finds the first difference in and across the blocks compared bytewise", [] {
+                vector<int> a(1000), b(1000);
+                expect(detail::firstMismatch(a.data(), b.data(), a.size())).to.equal(1000u);
+                for (size_t i : {999u, 64u, 63u, 0u}) {
+                    b[i] = 1;
+                    expect(detail::firstMismatch(a.data(), b.data(), a.size())).to.equal(i);
+                }
+            });
+            it("compares other types with operator==", [] {
+                vector<double> a{1, 0.0, 3}, b{1, -0.0, 4};
+                expect(detail::firstMismatch(a.data(), b.data(), a.size())).to.equal(2u);
+            });
+        });
+        describe("Timing", [] {
+            it("flags a duration significantly above it's history as regression", [] {
+                detail::Timing timing;
+                for (auto duration : {2ms, 3ms, 2ms, 3ms, 2ms}) {
+                    timing.add(duration);
+                }
+                expect(timing.count).to.equal(5u);
+                expect(timing.mean).to.be.within(2e6f, 3e6f);
+                expect(timing.regressed(3ms)).to.beFalse();
+                expect(timing.regressed(10ms)).to.beTrue();
+            });
+            it("needs some history to flag a regression", [] {
+                detail::Timing timing;
+                timing.add(2ms);
+                expect(timing.regressed(10ms)).to.beFalse();
+            });
+        });
+        describe("BufferedWriter", [] {
+            it("writes when flushed and when it's buffer is full", [] {
+                int fds[2];
+                expect(pipe(fds)).to.equal(0);
+                fcntl(fds[0], F_SETFL, O_NONBLOCK);
+                char buffer[256 * 1024];
+                {
+                    detail::BufferedWriter out(fds[1], true);
+                    out << "hello";
+                    expect(read(fds[0], buffer, sizeof(buffer))).to.equal(-1);
+                    out.flush();
+                    expect(read(fds[0], buffer, sizeof(buffer))).to.equal(5);
+                    out << string(40000, 'a') << string(40000, 'b');
+                    expect(read(fds[0], buffer, sizeof(buffer))).to.equal(40000);
+                    out << "!";
+                }
+                expect(read(fds[0], buffer, sizeof(buffer))).to.equal(40001);
+                close(fds[0]);
+            });
+            it("open() a file descriptor", [] {
+                expect(detail::BufferedWriter::open("&1").get()).to.not_().equal(nullptr);
+                expect(detail::BufferedWriter::open("&x").get()).to.equal(nullptr);
+            });
+        });
+        describe("escape", [] {
+            it("escapeXml()", [] { expect(detail::escapeXml("a<b>&\"'\x01")).to.equal("a&lt;b&gt;&amp;&quot;&apos;?"); });
+            it("escapeXmlAttribute()", [] { expect(detail::escapeXmlAttribute("a<b\n\tc\r\n")).to.equal("a&lt;b&#10;&#9;c&#13;&#10;"); });
+            it("escapeJson()", [] { expect(detail::escapeJson("a\"\\\n\x01")).to.equal("\"a\\\"\\\\\\n\\u0001\""); });
+        });
+        describe("TimingDatabase", [] {
+            it("save() and load()", [] {
+                auto filename = (filesystem::temp_directory_path() / format("kaffeeklatsch-{}.timings", getpid())).string();
+                detail::TimingDatabase out;
+                out.add(42, 10ms);
+                out.add(42, 20ms);
+                out.add(7, 1ms);
+                expect(out.save(filename)).to.beTrue();
+                detail::TimingDatabase in;
+                expect(in.load(filename)).to.beTrue();
+                filesystem::remove(filename);
+                expect(in.find(42) != nullptr).to.beTrue();
+                expect(in.find(42)->count).to.equal(2u);
+                expect(in.find(42)->mean).to.equal(out.find(42)->mean);
+                expect(in.find(7)->mean).to.equal(1e6f);
+                expect(in.find(8) == nullptr).to.beTrue();
+            });
+            it("load() fails on a missing file", [] {
+                detail::TimingDatabase in;
+                expect(in.load("/nonexistent/kaffeeklatsch.timings")).to.beFalse();
+                expect(in.empty()).to.beTrue();
+            });
+            it("load() fails on a count beyond the records in the file", [] {
+                auto filename = (filesystem::temp_directory_path() / format("kaffeeklatsch-{}.timings", getpid())).string();
+                detail::TimingDatabase out;
+                out.add(42, 10ms);
+                expect(out.save(filename)).to.beTrue();
+                {
+                    fstream file(filename, ios::in | ios::out | ios::binary);
+                    uint32_t count = numeric_limits<uint32_t>::max();
+                    file.seekp(8);
+                    file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+                }
+                detail::TimingDatabase in;
+                expect(in.load(filename)).to.beFalse();
+                filesystem::remove(filename);
+                expect(in.empty()).to.beTrue();
+            });
+        });
+        describe("BaselineDatabase", [] {
+            it("save() and load()", [] {
+                auto filename = (filesystem::temp_directory_path() / format("kaffeeklatsch-{}.baseline", getpid())).string();
+                detail::BaselineDatabase out;
+                uint64_t id = 0;
+                array<double, detail::Benchmark::maxSamples> values;
+                detail::tmp_spec(
+                    detail::Options(),
+                    [] {
+                        describe("group", [] {
+                            it("example", [] {});
+                            bench("bench", [] {});
+                        });
+                    },
+                    [&](const detail::Statistics &, detail::ExampleGroup *root) {
+                        auto group = dynamic_cast<detail::ExampleGroup *>(root->items[0].get());
+                        auto example = dynamic_cast<detail::Example *>(group->items[1].get());
+                        id = example->m_id;
+                        values = example->benchmark.values;
+                        out.update(root);
+                        expect(out.find(group->items[0]->m_id) == nullptr).to.beTrue();
+                    });
+                expect(out.save(filename)).to.beTrue();
+                expect(filesystem::exists(filename + ".tmp")).to.beFalse();
+                detail::BaselineDatabase in;
+                expect(in.load(filename)).to.beTrue();
+                filesystem::remove(filename);
+                expect(in.find(id) != nullptr).to.beTrue();
+                expect(*in.find(id)).to.equal(vector<double>(values.begin(), values.end()));
+            });
+            it("load() fails on a missing file", [] {
+                detail::BaselineDatabase in;
+                expect(in.load("/nonexistent/kaffeeklatsch.baseline")).to.beFalse();
+            });
+        });
+        describe("mannWhitneyU(a, b)", [] {
+            it("is exact for few samples", [] {
+                expect(detail::mannWhitneyU({2}, {1})).to.equal(0.5);
+                expect(detail::mannWhitneyU({3, 4}, {1, 2})).to.equal(1.0 / 6);
+                expect(detail::mannWhitneyU({1, 2}, {3, 4})).to.equal(1.0);
+                expect(detail::mannWhitneyU({1, 4}, {2, 3})).to.equal(4.0 / 6);
+            });
+            it("is small when a is above b", [] {
+                vector<double> a, b;
+                for (int i = 0; i < 10; ++i) {
+                    a.push_back(20 + i);
+                    b.push_back(10 + i);
+                }
+                expect(detail::mannWhitneyU(a, b)).to.be.below(1e-5);
+                expect(detail::mannWhitneyU(b, a)).to.equal(1.0);
+            });
+            it("approximates many samples with the normal distribution", [] {
+                vector<double> a, b, c;
+                for (int i = 0; i < 40; ++i) {
+                    a.push_back(i);
+                    b.push_back(i + 0.5);
+                    c.push_back(i + 30);
+                }
+                expect(detail::mannWhitneyU(a, b)).to.be.within(0.4, 0.6);
+                expect(detail::mannWhitneyU(c, a)).to.be.below(1e-6);
+            });
+        });
+        describe("shiftEstimate(a, b)", [] {
+            it("is the median of the pairwise differences", [] {
+                expect(detail::shiftEstimate({11, 12, 13}, {1, 2, 3})).to.equal(10.0);
+                expect(detail::shiftEstimate({1, 2}, {2, 4})).to.equal(-1.5);
+                expect(detail::shiftEstimate({}, {1})).to.equal(0.0);
+            });
+        });
+        describe("parseOptions(...)", [] {
+            it("--jobs=<n>", [] {
+                const char *argv[] = {"tests", "--jobs=3"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.jobs).to.equal(3u);
+            });
+            it("--shard=<i>/<n>", [] {
+                const char *argv[] = {"tests", "--shard=2/3"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.shard).to.equal(2u);
+                expect(options.shards).to.equal(3u);
+            });
+            it("error: --shard=<i>/<n> with i > n", [] {
+                const char *argv[] = {"tests", "--shard=4/3"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+            it("--path=<path>", [] {
+                const char *argv[] = {"tests", "--path=a > b", "--path=c"};
+                detail::Options options;
+                expect(detail::parseOptions(3, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.paths).to.equal(vector<string>{"a > b", "c"});
+                expect(detail::splitPath(options.paths[0])).to.equal(vector<string>{"a", "b"});
+            });
+            it("error: --grep=<regex> with invalid regular expression", [] {
+                const char *argv[] = {"tests", "--grep=("};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+            it("--trace=<file>", [] {
+                const char *argv[] = {"tests", "--trace=run.json"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.trace).to.equal("run.json");
+            });
+            it("--baseline=<file> --save-baseline --significance=<p>", [] {
+                const char *argv[] = {"tests", "--baseline=bench.baseline", "--save-baseline", "--significance=0.05"};
+                detail::Options options;
+                expect(detail::parseOptions(4, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.baseline).to.equal("bench.baseline");
+                expect(options.saveBaseline).to.beTrue();
+                expect(options.significance).to.equal(0.05);
+            });
+            it("--regression-threshold=<percent>%", [] {
+                const char *argv[] = {"tests", "--regression-threshold=2.5%"};
+                detail::Options options;
+                expect(options.regressionThreshold).to.equal(0.05);
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.regressionThreshold).to.equal(0.025);
+                const char *invalid[] = {"tests", "--regression-threshold=-1%"};
+                expect(detail::parseOptions(2, const_cast<char **>(invalid), &options)).to.beFalse();
+            });
+            it("error: --significance=<p> outside of 0 < p < 1", [] {
+                const char *argv[] = {"tests", "--significance=1"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+            it("error: --save-baseline without --baseline=<file>", [] {
+                const char *argv[] = {"tests", "--save-baseline"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+            it("--timings=<file> --status=<file> --only-failures", [] {
+                const char *argv[] = {"tests", "--timings=t", "--status=s", "--only-failures"};
+                detail::Options options;
+                expect(options.timings).to.equal("");
+                expect(options.status).to.equal("");
+                expect(detail::parseOptions(4, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.timings).to.equal("t");
+                expect(options.status).to.equal("s");
+                expect(options.only.has_value()).to.beTrue();
+            });
+            it("error: --only-failures without --status=<file>", [] {
+                const char *argv[] = {"tests", "--only-failures"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+            it("--snapshots=<file> --update-snapshots", [] {
+                const char *argv[] = {"tests", "--snapshots=golden.bin", "--update-snapshots"};
+                detail::Options options;
+                expect(options.snapshots).to.equal(".kaffeeklatsch-snapshots");
+                expect(detail::parseOptions(3, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.snapshots).to.equal("golden.bin");
+                expect(options.updateSnapshots).to.beTrue();
+            });
+            it("--cases=<n> --seed=<n>", [] {
+                const char *argv[] = {"tests", "--cases=1000", "--seed=42"};
+                detail::Options options;
+                expect(options.cases).to.equal(100u);
+                expect(options.seed.has_value()).to.beFalse();
+                expect(detail::parseOptions(3, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.cases).to.equal(1000u);
+                expect(*options.seed).to.equal(42u);
+            });
+            it("error: --cases=0", [] {
+                const char *argv[] = {"tests", "--cases=0"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+            it("--counters", [] {
+                const char *argv[] = {"tests", "--counters"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.counters).to.beTrue();
+            });
+            it("--top=<metric>[:<n>]", [] {
+                const char *argv[] = {"tests", "--top=faults:5"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.top).to.equal("faults");
+                expect(options.topCount).to.equal(5u);
+            });
+            it("error: --top=<metric> with unknown metric", [] {
+                const char *argv[] = {"tests", "--top=heat"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+            it("--timeout=<ms>", [] {
+                const char *argv[] = {"tests", "--timeout=150"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.timeout == 150ms).to.beTrue();
+            });
+            it("--grace=<ms>", [] {
+                const char *argv[] = {"tests", "--grace=500"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.grace == 500ms).to.beTrue();
+            });
+            it("--reporter=<name>:<destination>", [] {
+                const char *argv[] = {"tests", "--reporter=junit:report.xml", "--reporter=console"};
+                detail::Options options;
+                expect(detail::parseOptions(3, const_cast<char **>(argv), &options)).to.beTrue();
+                expect(options.reporters).to.equal(vector<string>{"junit:report.xml", "console"});
+            });
+            it("error: --reporter=<name> with unknown name", [] {
+                const char *argv[] = {"tests", "--reporter=html"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+            it("error: unknown option", [] {
+                const char *argv[] = {"tests", "--jobs3"};
+                detail::Options options;
+                expect(detail::parseOptions(2, const_cast<char **>(argv), &options)).to.beFalse();
+            });
+        });
     });
 });